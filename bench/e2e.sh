@@ -0,0 +1,52 @@
+#!/bin/sh
+# @file e2e.sh
+# @brief End-to-end throughput benchmark of p2nprobe against tools/collector over loopback
+# @author Jakub Gryc <xgrycj03>
+#
+# Usage: bench/e2e.sh [<pcap>] [<p2nprobe options>...]
+# Without a pcap a synthetic one is generated by tools/pcapgen (see the variables below).
+# Prints the collector summary and the records exported by p2nprobe, exits with 1 on loss.
+
+cd "$(dirname "$0")/.." || exit 1
+
+PORT=${PORT:-19995}
+FLOWS=${FLOWS:-500}
+PACKETS=${PACKETS:-200000}
+IDLE=1000
+WORK=$(mktemp -d)
+COLLECTOR=
+# The collector only stops after it has received data, stop it if p2nprobe fails
+trap '[ -n "$COLLECTOR" ] && kill $COLLECTOR 2>/dev/null; rm -rf "$WORK"' EXIT
+
+if [ $# -gt 0 ] && [ -f "$1" ]; then
+    PCAP=$1
+    shift
+else
+    PCAP=$WORK/e2e.pcap
+    ./tools/pcapgen -o "$PCAP" --flows "$FLOWS" --packets "$PACKETS" --rate 50000 2>/dev/null || exit 1
+fi
+
+./tools/collector -p "$PORT" --idle "$IDLE" > "$WORK/collector.json" &
+COLLECTOR=$!
+sleep 0.2
+
+START=$(date +%s.%N)
+./p2nprobe "127.0.0.1:$PORT" "$PCAP" --stats "$@" 2> "$WORK/stats.json" || exit 1
+END=$(date +%s.%N)
+# Without any export (non-TCP input, --file, --shm) the collector would wait for the
+# first datagram forever, SIGTERM makes it print the summary once it had the idle time
+( sleep $((IDLE / 1000 + 1)); kill $COLLECTOR 2>/dev/null ) &
+WATCHDOG=$!
+wait $COLLECTOR
+kill $WATCHDOG 2>/dev/null
+
+EXPORTED=$(sed -n 's/.*"records_exported": \([0-9]*\).*/\1/p' "$WORK/stats.json")
+RECEIVED=$(sed -n 's/.*"records": \([0-9]*\).*/\1/p' "$WORK/collector.json")
+
+echo "collector $(cat "$WORK/collector.json")"
+echo "p2nprobe records_exported $EXPORTED wall_seconds $(awk "BEGIN { print $END - $START }")"
+if [ "$EXPORTED" != "$RECEIVED" ]; then
+    echo "loss $((EXPORTED - RECEIVED)) records"
+    exit 1
+fi
+echo "loss 0 records"
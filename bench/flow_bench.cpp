@@ -0,0 +1,280 @@
+/**
+ * @file flow_bench.cpp
+ * @brief Microbenchmarks of the flow cache, packet decoder and record encoder
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * Usage: ./flow_bench [<filter>]
+ * Every benchmark prints one JSON line with ns/op, operations per second and heap
+ * allocations per operation. With a filter only benchmarks whose name contains it run.
+ */
+
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/ExportSink.h"
+#include "../include/FlowCache.h"
+#include "../include/PcapHandler.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Heap allocations are counted by replacing the global operator new
+static uint64_t allocations = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+
+/**
+ * @class NullSink
+ * @brief Export target which assembles the datagrams and drops them
+ */
+class NullSink : public ExportSink {
+   public:
+    bool connect() override { return true; }
+    uint64_t bytes = 0;
+
+   protected:
+    char *beginDatagram() override { return buffer; }
+    bool commitDatagram(size_t size) override {
+        bytes += size;
+        return true;
+    }
+
+   private:
+    char buffer[MAX_DATAGRAM_SIZE];
+};
+
+/**
+ * @class Measurement
+ * @brief Measures time and allocations of a number of operations
+ */
+class Measurement {
+   public:
+    Measurement() : startAllocations(allocations), start(Clock::now()) {}
+
+    void report(const std::string &name, const std::string &params, uint64_t ops, const char *unit = "op") {
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        uint64_t allocated = allocations - startAllocations;
+        printf("{\"bench\":\"%s\",%s\"ops\":%llu,\"ns_per_%s\":%.1f,\"%ss_per_sec\":%.0f,\"allocs_per_%s\":%.2f}\n",
+               name.c_str(), params.c_str(), static_cast<unsigned long long>(ops), unit, ns / ops, unit,
+               ops / (ns / 1e9), unit, static_cast<double>(allocated) / ops);
+        fflush(stdout);
+    }
+
+   private:
+    uint64_t startAllocations;
+    Clock::time_point start;
+};
+
+/**
+ * @brief Returns flow indexes following a Zipf distribution with exponent s
+ */
+static std::vector<uint32_t> zipfSequence(uint32_t flows, size_t count, double s, std::mt19937_64 &rng) {
+    std::vector<double> cdf(flows);
+    double sum = 0;
+    for (uint32_t i = 0; i < flows; i++) {
+        sum += 1.0 / std::pow(i + 1, s);
+        cdf[i] = sum;
+    }
+
+    std::uniform_real_distribution<double> uniform(0, sum);
+    std::vector<uint32_t> sequence(count);
+    for (auto &index : sequence) {
+        index = static_cast<uint32_t>(std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin());
+    }
+    return sequence;
+}
+
+/**
+ * @brief Returns a packet of the flow with the given index, addresses and ports in network byte order
+ */
+static PcapData flowOf(uint32_t index, struct timeval time) {
+    PcapData packet;
+    packet.srcIP = htonl(0x0a000000 | (index & 0xffffff));
+    packet.destIP = htonl(0xc0a80001 + (index >> 24));
+    packet.srcPort = htons(static_cast<uint16_t>(1024 + (index & 0x3fff)));
+    packet.destPort = htons(443);
+    packet.timeData = time;
+    packet.tcpFlags = TH_ACK;
+    packet.protocol = IPPROTO_TCP;
+    packet.tos = 0;
+    return packet;
+}
+
+static bool selected(const char *filter, const char *name) { return !filter || strstr(name, filter); }
+
+/**
+ * @brief Fills the cache with flows 0 .. flows-1
+ */
+template <class Cache>
+static void populate(Cache &cache, uint32_t flows, struct timeval now) {
+    for (uint32_t i = 0; i < flows; i++) {
+        cache.handlePacket(flowOf(i, now), 100);
+    }
+}
+
+/**
+ * @brief handlePacket on a table of the given size, timeouts never expire
+ */
+template <class Key, class Counters>
+static void benchHandleFlow(const char *key, uint32_t flows, bool zipf) {
+    std::mt19937_64 rng(flows);
+    const size_t ops = 2000000;
+
+    std::vector<uint32_t> sequence;
+    if (zipf) {
+        sequence = zipfSequence(flows, ops, 1.0, rng);
+    } else {
+        std::uniform_int_distribution<uint32_t> uniform(0, flows - 1);
+        sequence.resize(ops);
+        for (auto &index : sequence) index = uniform(rng);
+    }
+
+    Timer timer(1000000, 1000000);
+    BasicFlowCache<Key, Counters> cache(timer);
+    struct timeval now = {1700000000, 0};
+    populate(cache, flows, now);
+
+    Measurement measurement;
+    for (size_t i = 0; i < ops; i++) {
+        now.tv_usec = static_cast<suseconds_t>(i % 1000000);
+        cache.handlePacket(flowOf(sequence[i], now), 100);
+    }
+    measurement.report("handle_flow", "\"flow_key\":\"" + std::string(key) + "\",\"counters\":" +
+                                          std::to_string(Counters::bits) + ",\"flows\":" + std::to_string(flows) +
+                                          ",\"keys\":\"" + (zipf ? "zipf" : "uniform") + "\",",
+                       ops, "packet");
+}
+
+/**
+ * @brief handlePacket on a stream of new flows, the timeouts decide the table size
+ */
+static void benchExpiry(uint32_t timeout) {
+    const size_t ops = 2000000;
+    const uint32_t packetsPerSecond = 10000;
+
+    Timer timer(static_cast<int>(timeout), static_cast<int>(timeout));
+    FlowCache cache(timer);
+    NullSink sink;
+
+    Measurement measurement;
+    struct timeval now = {1700000000, 0};
+    for (size_t i = 0; i < ops; i++) {
+        now.tv_sec = 1700000000 + static_cast<time_t>(i / packetsPerSecond);
+        now.tv_usec = static_cast<suseconds_t>((i % packetsPerSecond) * (1000000 / packetsPerSecond));
+        if (cache.exportCacheFull()) {
+            sink.sendFlows(cache.getExportCache(), timer, true);
+        }
+        // Every flow gets a few packets, so flows are created and expired continuously
+        cache.handlePacket(flowOf(static_cast<uint32_t>(i / 4), now), 100);
+    }
+    measurement.report("expiry", "\"timeout_s\":" + std::to_string(timeout) + ",\"packets_per_s\":" +
+                                     std::to_string(packetsPerSecond) + ",",
+                       ops, "packet");
+}
+
+/**
+ * @brief proccessPacket on a TCP packet
+ */
+static void benchDecode() {
+    const size_t ops = 20000000;
+    u_char packet[128];
+    memset(packet, 0, sizeof(packet));
+
+    struct ether_header *eth = reinterpret_cast<struct ether_header *>(packet);
+    eth->ether_type = htons(ETHERTYPE_IP);
+    struct ip *ip = reinterpret_cast<struct ip *>(packet + sizeof(*eth));
+    ip->ip_v = 4;
+    ip->ip_hl = 5;
+    ip->ip_p = IPPROTO_TCP;
+    ip->ip_src.s_addr = htonl(0x0a000001);
+    ip->ip_dst.s_addr = htonl(0xc0a80001);
+    struct tcphdr *tcp = reinterpret_cast<struct tcphdr *>(packet + sizeof(*eth) + 20);
+    tcp->source = htons(1024);
+    tcp->dest = htons(443);
+    tcp->th_flags = TH_ACK;
+
+    struct pcap_pkthdr header;
+    header.ts = {1700000000, 0};
+    header.caplen = sizeof(packet);
+    header.len = 1500;
+
+    PcapData data;
+    uint64_t checksum = 0;
+    Measurement measurement;
+    for (size_t i = 0; i < ops; i++) {
+        header.ts.tv_usec = static_cast<suseconds_t>(i & 0xfffff);
+        checksum += static_cast<uint64_t>(PcapHandler::proccessPacket(&header, packet, &data)) + data.srcPort;
+    }
+    measurement.report("decode", "\"checksum\":" + std::to_string(checksum) + ",", ops, "packet");
+}
+
+/**
+ * @brief Encoding of the flows into records and sendFlows to a sink dropping the datagrams
+ */
+static void benchExport(uint32_t flows) {
+    Timer timer(1000000, 1000000);
+    FlowCache cache(timer);
+    NullSink sink;
+    populate(cache, flows, {1700000000, 0});
+
+    Measurement encode;
+    cache.flushToExportAll();
+    encode.report("encode", "\"flows\":" + std::to_string(flows) + ",", flows, "record");
+
+    Measurement send;
+    sink.sendFlows(cache.getExportCache(), timer, false);
+    send.report("send_null", "\"flows\":" + std::to_string(flows) + ",", flows, "record");
+}
+
+int main(int argc, char *argv[]) {
+    const char *filter = argc > 1 ? argv[1] : nullptr;
+
+    // The linked sources are built with the same flags as this file (BENCH_CXXFLAGS)
+#ifdef __OPTIMIZE__
+    printf("{\"bench\":\"build\",\"optimized\":true}\n");
+#else
+    printf("{\"bench\":\"build\",\"optimized\":false}\n");
+#endif
+
+    if (selected(filter, "handle_flow")) {
+        for (uint32_t flows : {1000U, 10000U, 100000U, 1000000U}) {
+            benchHandleFlow<FourTupleKey, Counters32>("4tuple", flows, false);
+            benchHandleFlow<FourTupleKey, Counters32>("4tuple", flows, true);
+        }
+        benchHandleFlow<FiveTupleKey, Counters32>("5tuple", 100000, false);
+        benchHandleFlow<AddressPairKey, Counters64>("pair", 100000, false);
+    }
+    if (selected(filter, "expiry")) {
+        for (uint32_t timeout : {1U, 10U, 60U}) {
+            benchExpiry(timeout);
+        }
+    }
+    if (selected(filter, "decode")) {
+        benchDecode();
+    }
+    if (selected(filter, "export")) {
+        benchExport(100000);
+    }
+
+    return 0;
+}
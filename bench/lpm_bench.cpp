@@ -0,0 +1,102 @@
+/**
+ * @file lpm_bench.cpp
+ * @brief Microbenchmark of the prefix table build, lookup and record enrichment
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * Usage: ./lpm_bench [<prefix count>]
+ * Builds a table of random prefixes (default one million, lengths weighted like a
+ * global routing table) and measures lookups of random addresses.
+ */
+
+#include <arpa/inet.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/PrefixTable.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedNs(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    size_t prefixCount = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    const size_t lookups = 20000000;
+
+    std::mt19937_64 rng(42);
+    // Mostly /24 with a share of shorter and a few longer prefixes
+    std::discrete_distribution<int> lengthDist({0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 2, 3, 5, 4, 10, 6, 10,
+                                                12, 25, 25, 60, 60, 600, 3, 3, 3, 3, 3, 3, 3, 3});
+
+    std::vector<PrefixTable::Route> routes(prefixCount);
+    for (size_t i = 0; i < prefixCount; i++) {
+        uint8_t length = static_cast<uint8_t>(lengthDist(rng));
+        routes[i].length = length;
+        routes[i].prefix = length == 0 ? 0 : static_cast<uint32_t>(rng()) & (0xffffffffU << (32 - length));
+        routes[i].info = RouteInfo{static_cast<uint32_t>(rng()), static_cast<uint16_t>(i), static_cast<uint16_t>(i % 64),
+                                   length};
+    }
+
+    PrefixTable table;
+    auto start = Clock::now();
+    table.build(routes);
+    double buildNs = elapsedNs(start);
+
+    std::vector<uint32_t> addresses(1 << 20);
+    for (auto &address : addresses) address = static_cast<uint32_t>(rng());
+
+    // Lookups of random addresses, the table does not fit into the cache
+    uint64_t matched = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < lookups; i++) {
+        const RouteInfo *info = table.find(addresses[i & (addresses.size() - 1)]);
+        matched += info != nullptr;
+    }
+    double lookupNs = elapsedNs(start) / lookups;
+
+    // Enrichment of whole records through the reloadable enricher
+    const char *path = "lpm_bench_prefixes.txt";
+    {
+        std::ofstream file(path);
+        char prefix[INET_ADDRSTRLEN];
+        for (const auto &route : routes) {
+            uint32_t networkOrder = htonl(route.prefix);
+            inet_ntop(AF_INET, &networkOrder, prefix, sizeof(prefix));
+            file << prefix << "/" << static_cast<int>(route.length) << " " << route.info.as << " 10.0.0.1 "
+                 << route.info.ifIndex << "\n";
+        }
+    }
+
+    PrefixEnricher enricher(path);
+    start = Clock::now();
+    bool loaded = enricher.start();
+    double loadNs = elapsedNs(start);
+    std::remove(path);
+    if (!loaded) return EXIT_FAILURE;
+
+    struct NetflowRecord record = {};
+    const size_t records = lookups / 2;
+    uint64_t checksum = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < records; i++) {
+        record.srcIP = addresses[(2 * i) & (addresses.size() - 1)];
+        record.destIP = addresses[(2 * i + 1) & (addresses.size() - 1)];
+        enricher.enrich(record);
+        checksum += record.srcAS + record.destMask;
+    }
+    double enrichNs = elapsedNs(start) / records;
+
+    printf("{\"bench\":\"lpm\",\"prefixes\":%zu,\"build_ms\":%.1f,\"load_file_ms\":%.1f,"
+           "\"lookup_ns\":%.2f,\"enrich_record_ns\":%.2f,\"matched\":%.3f,\"checksum\":%llu}\n",
+           table.size(), buildNs / 1e6, loadNs / 1e6, lookupNs, enrichNs,
+           static_cast<double>(matched) / lookups, static_cast<unsigned long long>(checksum));
+
+    return 0;
+}
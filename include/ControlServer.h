@@ -0,0 +1,145 @@
+/**
+ * @file ControlServer.h
+ * @brief Live inspection of the flow cache over a Unix domain socket
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#ifndef CONTROLSERVER_H
+#define CONTROLSERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal time between two snapshots
+#define CONTROL_MIN_INTERVAL_MS 200
+// Share of the time the packet loop may spend copying, in percent, stretches the interval for big caches
+#define CONTROL_COPY_BUDGET 2
+
+/**
+ * @class FlowView
+ * @brief Copy of one flow cache entry, addresses and ports in network byte order
+ */
+struct FlowView {
+    uint32_t srcIP, destIP;
+    uint16_t srcPort, destPort;
+    uint8_t protocol, tos, tcpFlags;
+    uint64_t packets, bytes;
+    int64_t firstSeen, lastSeen;  // capture time in microseconds
+};
+
+/**
+ * @class FlowSnapshot
+ * @brief Flow cache copied at one point of the packet loop
+ */
+struct FlowSnapshot {
+    std::vector<FlowView> flows;
+    int64_t captureTime = 0;  // capture time of the last packet in microseconds
+    uint64_t sequence = 0;
+    std::chrono::steady_clock::time_point taken;
+};
+
+/**
+ * @class ControlServer
+ * @brief Answers queries about the flow cache on a Unix domain socket
+ *
+ * The queries never touch the flow cache. When a client asks and the last snapshot is
+ * older than the snapshot interval, the server raises a flag, the packet loop copies
+ * the cache into a flat vector between two packets and publishes it. A published
+ * snapshot is immutable and shared by reference count, so any number of queries can
+ * read it while the packet loop goes on, and it is freed with its last reader. The
+ * packet loop only tests the flag per packet and holds the lock for a pointer swap.
+ *
+ * The interval is CONTROL_MIN_INTERVAL_MS, or longer if the last copy took more than
+ * CONTROL_COPY_BUDGET percent of it. The server thread runs with a lower priority, so
+ * on a busy CPU the queries wait for the packet loop and not the other way round. With
+ * --replay the copy is only made while the loop waits for a packet that is due later
+ * than the copy takes, a replay which is behind schedule answers with older snapshots.
+ *
+ * One command per connection, the answer is JSON, one object per line:
+ *   summary, top [N], oldest [N], dest [N], lookup <src> <sport> <dst> <dport>
+ * N is capped at 10000, a client which does not read the answer in 2 s is dropped.
+ */
+class ControlServer {
+   public:
+    /**
+     * @brief Constructor of the control server
+     *
+     * @param path path of the socket, an existing socket file is replaced, start()
+     *             fails if the path is taken by anything else
+     */
+    ControlServer(const std::string &path);
+
+    /**
+     * @brief Destroyer, stops the server thread and removes the socket
+     */
+    ~ControlServer();
+
+    /**
+     * @brief Binds the socket and starts the server thread
+     *
+     * @return true if the socket is listening
+     */
+    bool start();
+
+    /**
+     * @brief Tells the packet loop whether a snapshot is requested
+     */
+    inline bool wanted() const { return requested.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Returns how long the last copy took, lets a paced packet loop copy only when it has time
+     */
+    inline int64_t copyTime() const { return lastCopy; }
+
+    /**
+     * @brief Copies the flow cache and publishes the snapshot, called by the packet loop
+     *
+     * @param cache flow cache providing snapshot(std::vector<FlowView> &)
+     * @param captureTime capture time of the last packet in microseconds
+     */
+    template <class Cache>
+    void publish(const Cache &cache, int64_t captureTime) {
+        auto begin = std::chrono::steady_clock::now();
+        std::shared_ptr<FlowSnapshot> snapshot(new FlowSnapshot());
+        cache.snapshot(snapshot->flows);
+        snapshot->captureTime = captureTime;
+        snapshot->taken = std::chrono::steady_clock::now();
+        publish(std::move(snapshot), begin);
+    }
+
+   private:
+    void publish(std::shared_ptr<FlowSnapshot> snapshot, std::chrono::steady_clock::time_point begin);
+
+    /**
+     * @brief Returns a snapshot not older than the snapshot interval, or the last one
+     *        if the packet loop does not answer in time
+     */
+    std::shared_ptr<const FlowSnapshot> acquire();
+
+    void serveLoop();
+    void serve(int client);
+    std::string answer(const std::string &command);
+    std::string execute(const std::string &name, size_t count, const FlowView &key);
+
+    std::string path;
+    int listenFd;
+    std::atomic<bool> requested;
+    std::atomic<bool> stopping;
+    std::thread server;
+
+    std::mutex mutex;  // guards only the snapshot pointer
+    std::condition_variable published;
+    std::shared_ptr<const FlowSnapshot> current;
+    uint64_t sequence;
+    std::chrono::steady_clock::duration interval;
+    int64_t lastCopy;  // nanoseconds, only used by the packet loop
+};
+
+#endif
@@ -0,0 +1,88 @@
+/**
+ * @file ExportSink.h
+ * @brief Common interface of all flow export targets
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#ifndef EXPORTSINK_H
+#define EXPORTSINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+
+#include "Flow.h"
+#include "Tools.h"
+
+#define MAX_DATAGRAM_SIZE (sizeof(struct NetflowHeader) + sizeof(struct NetflowRecord) * MAX_PACKETS)
+
+/**
+ * @class ExportSink
+ * @brief Base class of the export targets
+ *
+ * The sink splits the export cache into Netflow v5 datagrams of at most 30 records,
+ * fills the header and keeps the flow sequence counter. Derived classes only provide
+ * the memory for a datagram and deliver it once it is complete.
+ */
+class ExportSink {
+   public:
+    virtual ~ExportSink() = default;
+
+    /**
+     * @brief Prepares the export target (socket, shared memory, ...)
+     *
+     * @return true if the target is ready to receive flows
+     */
+    virtual bool connect() = 0;
+
+    /**
+     * @brief Delivers everything still buffered, called once after the last sendFlows
+     *
+     * @return true if all exported datagrams were delivered
+     */
+    virtual bool finish() { return true; }
+
+    /**
+     * @brief Function which handles exporting already expirated flows
+     *
+     * @param exportCache queue of Netflow Records
+     * @param timer Timer class instance
+     * @param sendOnlyMAX if set to true the exporter maximizes the number of flows to send up to 30,
+     *        if there are less then 30 flows then it will not send any data
+     */
+    bool sendFlows(std::queue<struct NetflowRecord> &exportCache, Timer &timer, bool sendOnlyMAX);
+
+    /**
+     * @brief Returns the sequence number of the next exported flow
+     */
+    uint32_t getFlowSequence() const;
+
+    /**
+     * @brief Sets the sequence number of the next exported flow (continuing a previous run)
+     */
+    void setFlowSequence(uint32_t sequence);
+
+    /**
+     * @brief Sets the engine_id of the exported datagrams (the partition index with --partition)
+     */
+    void setEngineId(uint8_t engineId);
+
+   protected:
+    /**
+     * @brief Returns memory where the next datagram is built, at least MAX_DATAGRAM_SIZE bytes
+     */
+    virtual char *beginDatagram() = 0;
+
+    /**
+     * @brief Delivers the datagram built in the memory returned by beginDatagram()
+     *
+     * @param size size of the datagram in bytes
+     * @return true if the datagram was delivered
+     */
+    virtual bool commitDatagram(size_t size) = 0;
+
+    uint32_t flowSequence = 0;
+    uint8_t engineId = 0;
+};
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * @file FileExporter.h
+ * @brief Binary flow file exporter header file
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#ifndef FILEEXPORTER_H
+#define FILEEXPORTER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ExportSink.h"
+#include "FlowFile.h"
+
+/**
+ * @class FileExporter
+ * @brief Writes the exported records into binary flow files (see FlowFile.h)
+ *
+ * The records are collected into large aligned blocks in the exporting thread. Full
+ * blocks are handed over to a background writer thread, so the packet processing only
+ * waits for the disk when all block buffers are in use.
+ */
+class FileExporter : public ExportSink {
+   public:
+    /**
+     * @brief Constructor of FileExporter class
+     *
+     * @param path path of the output file, with rotation a file number is appended
+     * @param timer Timer class instance, its start time is stored in the file header
+     * @param directIO open the files with O_DIRECT to bypass the page cache
+     * @param rotateSize start a new file after this many bytes (0 = never)
+     * @param rotateTime start a new file after this many seconds (0 = never)
+     */
+    FileExporter(const std::string &path, Timer &timer, bool directIO, uint64_t rotateSize, uint32_t rotateTime);
+
+    /**
+     * @brief Destroyer of the exporter, writes the remaining records and closes the file
+     */
+    ~FileExporter() override;
+
+    /**
+     * @brief Allocates the block buffers and starts the writer thread
+     *
+     * @return true if the first file can be created
+     */
+    bool connect() override;
+
+    /**
+     * @brief Writes the last block, stops the writer thread and closes the file
+     *
+     * @return false if the writer thread failed to write any block
+     */
+    bool finish() override;
+
+   protected:
+    char *beginDatagram() override;
+
+    /**
+     * @brief Appends the records of the datagram to the current block
+     *
+     * @return false once the writer thread has failed, the records are then dropped
+     */
+    bool commitDatagram(size_t size) override;
+
+   private:
+    /**
+     * @class Block
+     * @brief Block buffer handed over to the writer thread
+     */
+    struct Block {
+        char *data;
+        bool rotateAfter;
+    };
+
+    /**
+     * @brief Fills the block header and hands the current block over to the writer thread
+     *
+     * @param rotateAfter close the file after this block
+     */
+    void submitBlock(bool rotateAfter);
+
+    /**
+     * @brief Takes a free block buffer, waits for the writer thread if there is none
+     */
+    void takeFreeBlock();
+
+    /**
+     * @brief Main loop of the writer thread
+     */
+    void writerLoop();
+
+    /**
+     * @brief Opens the next output file and writes its header (writer thread)
+     */
+    bool openFile();
+
+    /**
+     * @brief Writes the block index and closes the current file (writer thread)
+     */
+    void closeFile();
+
+    /**
+     * @brief Writes the whole buffer at the given offset (writer thread)
+     */
+    bool writeAt(const char *data, size_t size, uint64_t offset);
+
+    std::string path;
+    Timer &timer;
+    bool directIO;
+    uint64_t rotateSize;
+    uint32_t rotateTime;
+
+    // State of the exporting thread
+    char datagram[MAX_DATAGRAM_SIZE];
+    char *current;
+    uint32_t currentRecords;
+    uint32_t currentFirstSequence;
+    uint32_t currentMinFirst, currentMaxLast;
+    uint64_t submittedBytes;
+    struct timespec fileStartTime;
+
+    // Shared with the writer thread
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Block> fullBlocks;
+    std::vector<char *> freeBlocks;
+    std::vector<char *> allBlocks;
+    bool stopping;
+    std::thread writer;
+    std::atomic<bool> failed;  // latched by the writer thread on the first error
+
+    // State of the writer thread
+    int fd;
+    uint32_t fileNumber;
+    uint64_t fileOffset;
+    std::vector<FlowFileIndex> index;
+};
+
+#endif
@@ -9,6 +9,7 @@
 
 #define MAX_PACKETS 30
 
+#include <algorithm>
 #include <cstdint>
 #include <ctime>
 #include <iostream>
@@ -61,59 +62,79 @@ struct NetflowRecord {
 };
 
 /**
- * @class Flow
- * @brief Class representing single TCP Flow
- *
- * The class implementation stores and updates the state of each individual
- * network flow. Stores source and destination IP addresses, ports and byte/packet counts.
- * The flow gets updated when the packets to the belonging flow gets captured.
+ * @class PcapData
+ * @brief Fields of a decoded packet, addresses and ports in network byte order
+ */
+struct PcapData {
+    uint32_t srcIP;
+    uint32_t destIP;
+    uint16_t srcPort;
+    uint16_t destPort;
+    struct timeval timeData;
+    uint8_t tcpFlags;
+    uint8_t protocol;
+    uint8_t tos;
+    uint64_t fileOffset;  // offset of the packet record in the pcap file
+};
+
+/**
+ * @class Counters32
+ * @brief 32-bit packet and byte counters, they wrap around like the v5 record fields
  */
-class Flow {
-   public:
-    uint32_t srcIP, destIP;
-    uint16_t srcPort, destPort;
-    uint8_t  tcpFlags;
+struct Counters32 {
+    static constexpr uint16_t bits = 32;
     uint32_t packetCount, byteCount;
-    struct timeval startTime, lastSeenTime;
 
-    /**
-     * @brief Constructor for a Flow class
-     *
-     * @param srcIP Source IP address
-     * @param destIP Destination IP address
-     * @param srcPort Source port number
-     * @param destPort Destination port number
-     */
-    Flow(uint32_t srcIP, uint32_t destIP, uint16_t srcPort, uint16_t destPort, uint8_t tcpFlags);
+    void update(uint32_t packetSize) {
+        packetCount++;
+        byteCount += packetSize;
+    }
+    uint32_t exportPackets() const { return packetCount; }
+    uint32_t exportBytes() const { return byteCount; }
+};
 
-    /**
-     * @brief Function sets the first seen timestamp in milliseconds
-     *
-     * @param packetTime 
-     */
-    void setFirst(struct timeval packetTime, uint8_t tcpflgs);
+/**
+ * @class Counters64
+ * @brief 64-bit packet and byte counters, saturated to 32 bits in the exported record
+ */
+struct Counters64 {
+    static constexpr uint16_t bits = 64;
+    uint64_t packetCount, byteCount;
+
+    void update(uint32_t packetSize) {
+        packetCount++;
+        byteCount += packetSize;
+    }
+    uint32_t exportPackets() const { return static_cast<uint32_t>(std::min<uint64_t>(packetCount, UINT32_MAX)); }
+    uint32_t exportBytes() const { return static_cast<uint32_t>(std::min<uint64_t>(byteCount, UINT32_MAX)); }
+};
+
+/**
+ * @class FlowEntry
+ * @brief State of a single flow stored in the flow cache
+ *
+ * The key of the flow is stored separately as the key of the flow cache, the counters
+ * are given by the counter policy.
+ */
+template <class Counters>
+struct FlowEntry {
+    struct timeval startTime, lastSeenTime;
+    Counters counters;
+    uint32_t indexSlot;  // PacketIndex slot, only used with --packet-index
+    uint8_t tcpFlags;
 
     /**
      * @brief Function to update the flow statistics
      *
      * @param packetSize Packet size to be added to the flow
      * @param timestamp Current timestamp of the captured packet
+     * @param flags TCP flags of the packet
      */
-    void update(uint32_t packetSize, struct timeval timestamp);
-
-    /**
-     * @brief Function to determine if the flow is inactive
-     *
-     * @param currentTime Current time
-     * @param inactiveTimeout Inactive timeout specified by user (or implicit 30 seconds) [in seconds]
-     * @return True if the flow has been inactive for longer than the timeout
-     */
-    bool isInactive(std::time_t currentTime, std::time_t inactiveTimeout);
-
-    /**
-     * @brief Resets the flow data to 0
-     */
-    void clear();
+    void update(uint32_t packetSize, struct timeval timestamp, uint8_t flags) {
+        counters.update(packetSize);
+        lastSeenTime = timestamp;
+        tcpFlags |= flags;
+    }
 };
 
 #endif  // !_FLOW_H
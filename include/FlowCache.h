@@ -11,30 +11,50 @@
 #include <string>
 #include <unordered_map>
 #include <arpa/inet.h>
+#include <functional>
 #include <queue>
+#include <vector>
 
+#include "ControlServer.h"
 #include "Flow.h"
+#include "FlowKey.h"
+#include "PacketIndex.h"
+#include "PrefixTable.h"
 #include "Tools.h"
 
 /**
- * @class FlowCache
+ * @class BasicFlowCache
  * @brief Class representing cache of flows
  *
- * The Flow Cache class stores the individual flows in a hashmap.
+ * The Flow Cache class stores the individual flows in a hashmap. The key policy (see
+ * FlowKey.h) decides which packet fields make up a flow and the counter policy the width
+ * of the packet and byte counters. The prebuilt variants are instantiated in FlowCache.cpp.
+ *
+ * Besides the hashmap a min-heap of expiry deadlines is kept, so a packet only looks at
+ * the flows whose timeout may have passed instead of the whole cache. A deadline is only
+ * a lower bound (the flow may have been updated since), the timeouts are always checked
+ * again by Timer::checkFlowTimeouts before a flow is exported.
  */
-class FlowCache {
+template <class Key, class Counters>
+class BasicFlowCache {
    public:
-    
-    FlowCache(Timer &timer);
+
+    BasicFlowCache(Timer &timer);
 
     /**
      * @brief public function to update parameters of a flow such as timestamps and total packet size and count
      *
-     * @param flow current flow
+     * @param packet decoded packet
      * @param packetSize Packet size in bytes
      */
-    void handleFlow(const Flow &flow, uint32_t packetSize, struct timeval packetTime);
-    
+    void handlePacket(const PcapData &packet, uint32_t packetSize);
+
+    /**
+     * @brief exports the flows whose active or inactive timeout has expired
+     *
+     * @param timestamp current timestamp (capture time, or the scaled replay time during idle gaps)
+     */
+    void checkForExpiredFlows(struct timeval timestamp);
 
     /**
      * @brief flushes the flow cache to export cache
@@ -42,14 +62,14 @@ class FlowCache {
      */
     void flushToExportAll();
 
-    
+
     /**
      * @brief checks if the export cache is full
      *
      * @return true if the export cache is full (30 or more records), false otherwise
      */
     bool exportCacheFull();
-    
+
     /**
      * @brief returns the export cache
      *
@@ -57,6 +77,45 @@ class FlowCache {
      */
     std::queue<struct NetflowRecord> &getExportCache();
 
+    /**
+     * @brief writes the live flows, the records waiting for export and the flow sequence into a snapshot
+     *
+     * @param path path of the snapshot file
+     * @param flowSequence flow sequence of the exporter
+     * @return true if the snapshot was written
+     */
+    bool saveState(const std::string &path, uint32_t flowSequence);
+
+    /**
+     * @brief loads a snapshot written by saveState, the flow cache is expected to be empty
+     *
+     * @param path path of the snapshot file
+     * @param flowSequence flow sequence stored in the snapshot
+     * @return true if the snapshot was loaded
+     */
+    bool loadState(const std::string &path, uint32_t *flowSequence);
+
+    /**
+     * @brief sets the enricher filling the routing fields of exported records
+     *
+     * @param enricher prefix table enricher, nullptr to export zeros
+     */
+    void setEnricher(PrefixEnricher *enricher);
+
+    /**
+     * @brief sets the index receiving the packet offsets of the exported flows
+     *
+     * @param packetIndex packet offset index, nullptr to disable it (set before loadState)
+     */
+    void setPacketIndex(PacketIndex *packetIndex);
+
+    /**
+     * @brief copies the live flows for the control socket
+     *
+     * @param flows vector to be filled, the records waiting for export are not included
+     */
+    void snapshot(std::vector<FlowView> &flows) const;
+
     /**
      * @brief returns the flow cache
      *
@@ -65,31 +124,52 @@ class FlowCache {
     std::queue<struct NetflowRecord> exportCache;
 
    private:
-    
-    Timer timer;
+    using Entry = FlowEntry<Counters>;
 
     /**
-     * @brief loops through the flow cache and checks if any flow has expired, if so, it sends it to the export cache
-     *
-     * @param timestamp current timestamp
+     * @class Deadline
+     * @brief Earliest time (in microseconds) at which a flow can expire
      */
-    void checkForExpiredFlows(struct timeval timestamp);
+    struct Deadline {
+        int64_t time;
+        int64_t start;  // start of the flow, tells a stale deadline of a replaced flow
+        Key key;
+
+        bool operator>(const Deadline &other) const { return time > other.time; }
+    };
+
+    Timer timer;
+    PrefixEnricher *enricher = nullptr;
+    PacketIndex *packetIndex = nullptr;
+    int64_t activeTimeout, inactiveTimeout;  // microseconds
 
     /**
      * @brief prepares the flow to be exported
      *
+     * @param key key of the flow
      * @param flow current flow
      */
-    void prepareToExport(const std::shared_ptr<Flow> &flow);
+    void prepareToExport(const Key &key, const Entry &flow);
 
     /**
-     * @brief returns the key of the flow from the source and destination IPs and ports
+     * @brief adds the expiry deadline of the flow to the heap
      *
+     * @param key key of the flow
      * @param flow current flow
-     * @return key of the flow
      */
-    std::string getFlowKey(const Flow &flow);
-    std::unordered_map<std::string, std::shared_ptr<Flow>> flowCache;
+    void scheduleExpiry(const Key &key, const Entry &flow);
+
+    std::unordered_map<Key, Entry, FlowKeyHash> flowCache;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines;
 };
 
+extern template class BasicFlowCache<FourTupleKey, Counters32>;
+extern template class BasicFlowCache<FourTupleKey, Counters64>;
+extern template class BasicFlowCache<FiveTupleKey, Counters32>;
+extern template class BasicFlowCache<FiveTupleKey, Counters64>;
+extern template class BasicFlowCache<AddressPairKey, Counters32>;
+extern template class BasicFlowCache<AddressPairKey, Counters64>;
+
+using FlowCache = BasicFlowCache<FourTupleKey, Counters32>;
+
 #endif
@@ -0,0 +1,93 @@
+/**
+ * @file FlowFile.h
+ * @brief Layout of the binary flow files written by FileExporter
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * The file consists of aligned blocks, so it can be written with O_DIRECT:
+ *
+ *   offset 0                          FlowFileHeader, padded to FLOW_FILE_ALIGN bytes
+ *   offset FLOW_FILE_ALIGN+k*blockSize data block k, k = 0 .. n-1
+ *   after the last block              FlowFileIndex entry of every data block, padded to
+ *                                     FLOW_FILE_ALIGN, the last sizeof(FlowFileTrailer)
+ *                                     bytes of the file are the trailer
+ *
+ * A data block starts with FlowFileBlock followed by recordCount Netflow v5 records
+ * exactly as they are sent over UDP (network byte order). The rest of the block is
+ * zero filled. The firstSeen/lastSeen times are milliseconds since the start of the
+ * exporter, which is stored in the file header, so the absolute time of a record is
+ * startSec + firstSeen / 1000.
+ *
+ * A reader looking for a time range reads the trailer, then the index and only the
+ * blocks whose [minFirstSeen, maxLastSeen] overlaps the range. A file which was not
+ * closed properly has no trailer, its blocks can still be read sequentially.
+ *
+ * All integers outside of the records are in host byte order.
+ */
+
+#ifndef FLOWFILE_H
+#define FLOWFILE_H
+
+#include <cstdint>
+
+#define FLOW_FILE_MAGIC 0x464e3250        // "P2NF"
+#define FLOW_FILE_BLOCK_MAGIC 0x424e3250  // "P2NB"
+#define FLOW_FILE_INDEX_MAGIC 0x494e3250  // "P2NI"
+#define FLOW_FILE_VERSION 1
+#define FLOW_FILE_ALIGN 4096
+#define FLOW_FILE_BLOCK_SIZE (1 << 20)
+
+/**
+ * @class FlowFileHeader
+ * @brief Header at the beginning of the file
+ */
+struct FlowFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t blockSize;
+    uint32_t fileNumber;
+    int64_t startSec;
+    int64_t startUsec;
+};
+
+/**
+ * @class FlowFileBlock
+ * @brief Header of a data block
+ */
+struct FlowFileBlock {
+    uint32_t magic;
+    uint32_t recordCount;
+    uint32_t firstSequence;
+    uint32_t minFirstSeen;
+    uint32_t maxLastSeen;
+    uint32_t reserved[3];
+};
+
+/**
+ * @class FlowFileIndex
+ * @brief Index entry describing one data block
+ */
+struct FlowFileIndex {
+    uint64_t offset;
+    uint32_t recordCount;
+    uint32_t minFirstSeen;
+    uint32_t maxLastSeen;
+    uint32_t reserved;
+};
+
+/**
+ * @class FlowFileTrailer
+ * @brief Last bytes of a properly closed file, points to the index
+ */
+struct FlowFileTrailer {
+    uint32_t magic;
+    uint32_t entryCount;
+    uint64_t indexOffset;
+};
+
+static_assert(sizeof(FlowFileHeader) == 32, "FlowFileHeader layout changed");
+static_assert(sizeof(FlowFileBlock) == 32, "FlowFileBlock layout changed");
+static_assert(sizeof(FlowFileIndex) == 24, "FlowFileIndex layout changed");
+static_assert(sizeof(FlowFileTrailer) == 16, "FlowFileTrailer layout changed");
+
+#endif
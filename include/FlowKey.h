@@ -0,0 +1,172 @@
+/**
+ * @file FlowKey.h
+ * @brief Flow key policies of the flow cache
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * A key policy defines which packet fields make up a flow. Every policy provides:
+ *
+ *   fromPacket(PcapData)      builds the key of a decoded packet
+ *   operator==, hash()        compare and hash without branches on the fields
+ *   partitionHash()           hash equal for both directions, used by --partition
+ *   toRecord(NetflowRecord)   fills the key fields of the exported record
+ *   toEntry / fromEntry       conversion to and from the state snapshot
+ *
+ * FlowCache is instantiated for each policy, so the per-packet path is specialized at
+ * compile time instead of checking the configuration for every packet.
+ */
+
+#ifndef FLOWKEY_H
+#define FLOWKEY_H
+
+#include <netinet/in.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "Flow.h"
+#include "FlowState.h"
+
+/**
+ * @brief Mixes two 64-bit words into a hash (multiply and xor-shift, no branches)
+ */
+static inline size_t flowHash(uint64_t a, uint64_t b) {
+    uint64_t h = a * 0x9e3779b97f4a7c15ULL ^ b * 0xc2b2ae3d27d4eb4fULL;
+    h ^= h >> 32;
+    h *= 0xd6e8feb86659fd93ULL;
+    h ^= h >> 32;
+    return static_cast<size_t>(h);
+}
+
+/**
+ * @class FlowKeyHash
+ * @brief Hash functor for unordered containers keyed by a flow key
+ */
+struct FlowKeyHash {
+    template <class Key>
+    size_t operator()(const Key &key) const {
+        return key.hash();
+    }
+};
+
+/**
+ * @class FourTupleKey
+ * @brief Source and destination address and port (the default)
+ */
+struct FourTupleKey {
+    static constexpr uint16_t id = 1;
+    uint32_t srcIP, destIP;
+    uint16_t srcPort, destPort;
+
+    static FourTupleKey fromPacket(const PcapData &packet) {
+        return {packet.srcIP, packet.destIP, packet.srcPort, packet.destPort};
+    }
+    bool operator==(const FourTupleKey &other) const {
+        return ((srcIP ^ other.srcIP) | (destIP ^ other.destIP) | (ports() ^ other.ports())) == 0;
+    }
+    size_t hash() const { return flowHash(static_cast<uint64_t>(srcIP) << 32 | destIP, ports()); }
+    uint64_t partitionHash() const {
+        uint64_t a = static_cast<uint64_t>(srcIP) << 16 | srcPort, b = static_cast<uint64_t>(destIP) << 16 | destPort;
+        return flowHash(std::min(a, b), std::max(a, b));
+    }
+    void toRecord(struct NetflowRecord &record) const {
+        record.srcIP = srcIP;
+        record.destIP = destIP;
+        record.srcPort = srcPort;
+        record.destPort = destPort;
+        record.protocol = IPPROTO_TCP;
+        record.tos = 0;
+    }
+    void toEntry(struct FlowStateEntry &entry) const {
+        entry.srcIP = srcIP;
+        entry.destIP = destIP;
+        entry.srcPort = srcPort;
+        entry.destPort = destPort;
+    }
+    static FourTupleKey fromEntry(const struct FlowStateEntry &entry) {
+        return {entry.srcIP, entry.destIP, entry.srcPort, entry.destPort};
+    }
+
+   private:
+    uint32_t ports() const { return static_cast<uint32_t>(srcPort) << 16 | destPort; }
+};
+
+/**
+ * @class FiveTupleKey
+ * @brief Addresses, ports, protocol and type of service
+ */
+struct FiveTupleKey {
+    static constexpr uint16_t id = 2;
+    uint32_t srcIP, destIP;
+    uint16_t srcPort, destPort;
+    uint8_t protocol, tos;
+
+    static FiveTupleKey fromPacket(const PcapData &packet) {
+        return {packet.srcIP, packet.destIP, packet.srcPort, packet.destPort, packet.protocol, packet.tos};
+    }
+    bool operator==(const FiveTupleKey &other) const {
+        return ((srcIP ^ other.srcIP) | (destIP ^ other.destIP) | (rest() ^ other.rest())) == 0;
+    }
+    size_t hash() const { return flowHash(static_cast<uint64_t>(srcIP) << 32 | destIP, rest()); }
+    uint64_t partitionHash() const {
+        // ToS may differ between the directions, it is left out
+        uint64_t a = static_cast<uint64_t>(srcIP) << 16 | srcPort, b = static_cast<uint64_t>(destIP) << 16 | destPort;
+        return flowHash(std::min(a, b), std::max(a, b) ^ static_cast<uint64_t>(protocol) << 56);
+    }
+    void toRecord(struct NetflowRecord &record) const {
+        record.srcIP = srcIP;
+        record.destIP = destIP;
+        record.srcPort = srcPort;
+        record.destPort = destPort;
+        record.protocol = protocol;
+        record.tos = tos;
+    }
+    void toEntry(struct FlowStateEntry &entry) const {
+        entry.srcIP = srcIP;
+        entry.destIP = destIP;
+        entry.srcPort = srcPort;
+        entry.destPort = destPort;
+        entry.protocol = protocol;
+        entry.tos = tos;
+    }
+    static FiveTupleKey fromEntry(const struct FlowStateEntry &entry) {
+        return {entry.srcIP, entry.destIP, entry.srcPort, entry.destPort, entry.protocol, entry.tos};
+    }
+
+   private:
+    uint64_t rest() const {
+        return static_cast<uint64_t>(srcPort) << 32 | static_cast<uint64_t>(destPort) << 16 |
+               static_cast<uint64_t>(protocol) << 8 | tos;
+    }
+};
+
+/**
+ * @class AddressPairKey
+ * @brief Source and destination address only, the exported ports are zero
+ */
+struct AddressPairKey {
+    static constexpr uint16_t id = 3;
+    uint32_t srcIP, destIP;
+
+    static AddressPairKey fromPacket(const PcapData &packet) { return {packet.srcIP, packet.destIP}; }
+    bool operator==(const AddressPairKey &other) const {
+        return ((srcIP ^ other.srcIP) | (destIP ^ other.destIP)) == 0;
+    }
+    size_t hash() const { return flowHash(static_cast<uint64_t>(srcIP) << 32 | destIP, 0); }
+    uint64_t partitionHash() const { return flowHash(std::min(srcIP, destIP), std::max(srcIP, destIP)); }
+    void toRecord(struct NetflowRecord &record) const {
+        record.srcIP = srcIP;
+        record.destIP = destIP;
+        record.srcPort = 0;
+        record.destPort = 0;
+        record.protocol = IPPROTO_TCP;
+        record.tos = 0;
+    }
+    void toEntry(struct FlowStateEntry &entry) const {
+        entry.srcIP = srcIP;
+        entry.destIP = destIP;
+    }
+    static AddressPairKey fromEntry(const struct FlowStateEntry &entry) { return {entry.srcIP, entry.destIP}; }
+};
+
+#endif
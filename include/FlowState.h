@@ -0,0 +1,66 @@
+/**
+ * @file FlowState.h
+ * @brief Layout of the flow cache snapshot written by --save-state
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * The snapshot is a flat file which can be mapped into memory and read in place:
+ *
+ *   FlowStateHeader
+ *   flowCount   x FlowStateEntry   (live flows of the flow cache)
+ *   recordCount x NetflowRecord    (expired records not exported yet, network byte order,
+ *                                   firstSeen and lastSeen relative to the header start time)
+ *
+ * All other integers are in host byte order, the IP addresses and ports are stored in
+ * network byte order as in the decoded packet. The timestamps are the absolute pcap times,
+ * so the flows continue correctly in the next run. The already encoded records are moved
+ * to the start time of the loading run (with millisecond precision). Fields which are not part of the flow
+ * key (e.g. the ports with --flow-key pair) are zero, the counters are always 64-bit.
+ * A snapshot can only be loaded with the flow key and counters it was written with.
+ */
+
+#ifndef FLOWSTATE_H
+#define FLOWSTATE_H
+
+#include <cstdint>
+
+#define FLOW_STATE_MAGIC 0x534e3250  // "P2NS"
+#define FLOW_STATE_VERSION 3
+
+/**
+ * @class FlowStateHeader
+ * @brief Header of the snapshot
+ */
+struct FlowStateHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entrySize;
+    uint64_t flowCount;
+    uint64_t recordCount;
+    uint32_t flowSequence;
+    uint16_t flowKey;      // FlowKey id
+    uint16_t counterBits;  // 32 or 64
+    int64_t startSec;      // program start time of the run which wrote the snapshot
+    int32_t startUsec;
+    uint32_t pad;
+};
+
+/**
+ * @class FlowStateEntry
+ * @brief Stored state of a single flow
+ */
+struct FlowStateEntry {
+    uint32_t srcIP, destIP;
+    uint16_t srcPort, destPort;
+    uint8_t tcpFlags;
+    uint8_t protocol;
+    uint8_t tos;
+    uint8_t pad;
+    uint64_t packetCount, byteCount;
+    int64_t startSec, lastSeenSec;
+    int32_t startUsec, lastSeenUsec;
+};
+
+static_assert(sizeof(FlowStateHeader) == 48, "FlowStateHeader layout changed");
+static_assert(sizeof(FlowStateEntry) == 56, "FlowStateEntry layout changed");
+
+#endif
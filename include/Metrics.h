@@ -0,0 +1,145 @@
+/**
+ * @file Metrics.h
+ * @brief Runtime counters of the exporter
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Identifiers of the counters, the gauges are set instead of incremented
+ */
+enum class Metric {
+    PacketsSeen,
+    PacketsDecoded,
+    SkippedNonIP,
+    SkippedNonTCP,
+    SkippedTruncated,
+    SkippedPartition,
+    FlowsCreated,
+    FlowsExpiredActive,
+    FlowsExpiredInactive,
+    FlowsFlushed,
+    RecordsExported,
+    DatagramsExported,
+    ExportErrors,
+    ControlSnapshots,
+    ControlSnapshotTime,  // microseconds spent copying the flow cache
+    FlowCacheEntries,   // gauge
+    ExportQueueLength,  // gauge
+    ReplayLag,          // gauge, microseconds
+    Count
+};
+
+/**
+ * @class Metrics
+ * @brief Per-thread counters aggregated on demand
+ *
+ * Every thread updates only its own block of counters, so an update is a plain load
+ * and store without a locked instruction. The blocks are summed when a report is made.
+ */
+class Metrics {
+   public:
+    /**
+     * @brief Increments a counter of the calling thread
+     */
+    static inline void add(Metric metric, uint64_t value = 1) {
+        std::atomic<uint64_t> &counter = local()[static_cast<size_t>(metric)];
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Sets a gauge, every gauge is expected to be set only by one thread
+     */
+    static inline void set(Metric metric, uint64_t value) {
+        local()[static_cast<size_t>(metric)].store(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Sums the counters of all threads
+     *
+     * @param values array of Metric::Count values to be filled
+     */
+    static void collect(uint64_t *values);
+
+    /**
+     * @brief Returns the current values in the Prometheus text format
+     */
+    static std::string toPrometheus();
+
+    /**
+     * @brief Returns the current values as a JSON object
+     */
+    static std::string toJson();
+
+   private:
+    /**
+     * @brief Returns the counter block of the calling thread, registers it on first use
+     */
+    static inline std::atomic<uint64_t> *local() {
+        if (!block) block = registerThread();
+        return block;
+    }
+
+    static std::atomic<uint64_t> *registerThread();
+
+    static thread_local std::atomic<uint64_t> *block;
+};
+
+/**
+ * @class MetricsReporter
+ * @brief Periodically writes the metrics into a file
+ *
+ * The file is replaced atomically, so a reader always sees a complete report. Files
+ * ending with ".json" are written as JSON, other files in the Prometheus text format
+ * (suitable for the node exporter textfile collector).
+ */
+class MetricsReporter {
+   public:
+    /**
+     * @brief Constructor of the reporter
+     *
+     * @param path path of the report file
+     * @param interval seconds between two reports
+     */
+    MetricsReporter(const std::string &path, uint32_t interval);
+
+    /**
+     * @brief Destroyer, stops the reporting thread and writes the final report
+     */
+    ~MetricsReporter();
+
+    /**
+     * @brief Starts the reporting thread
+     */
+    void start();
+
+    /**
+     * @brief Writes the report now
+     *
+     * @return true if the file was written
+     */
+    bool write();
+
+   private:
+    void reportLoop();
+
+    std::string path;
+    uint32_t interval;
+    bool json;
+
+    std::mutex mutex;
+    std::condition_variable stopSignal;
+    bool stopping;
+    std::thread reporter;
+};
+
+#endif
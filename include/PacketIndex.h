@@ -0,0 +1,201 @@
+/**
+ * @file PacketIndex.h
+ * @brief Per-flow index of packet offsets in the pcap file (--packet-index)
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * Layout of the index file:
+ *
+ *   PacketIndexHeader followed by pathLength bytes of the pcap path
+ *   for every exported flow: PacketIndexEntry followed by dataSize bytes of offsets
+ *   PacketIndexLookup of every flow, sorted by the flow key and start time
+ *   PacketIndexTrailer
+ *
+ * The offsets point to the record headers of the flow's packets in the (classic) pcap
+ * file. They are stored as the difference to the previous offset (the first one to 0),
+ * each encoded as a LEB128 varint, so a packet usually takes 2 bytes. A lookup reads the
+ * trailer, binary searches the sorted table and reads a single entry.
+ *
+ * Addresses and ports are in network byte order as in the exported records, all other
+ * integers in host byte order. firstSeen is the value of the exported record.
+ */
+
+#ifndef PACKETINDEX_H
+#define PACKETINDEX_H
+
+#include <sys/time.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Flow.h"
+
+#define PACKET_INDEX_MAGIC 0x584e3250  // "P2NX"
+#define PACKET_INDEX_VERSION 1
+#define PACKET_INDEX_NO_SLOT UINT32_MAX
+#define PACKET_INDEX_CONTINUED 0x01    // the flow started in an earlier file (--load-state)
+
+/**
+ * @class PacketIndexHeader
+ * @brief Header of the index file
+ */
+struct PacketIndexHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t pathLength;
+};
+
+/**
+ * @class PacketIndexEntry
+ * @brief One exported flow and the size of its offset list
+ */
+struct PacketIndexEntry {
+    uint32_t srcIP, destIP;
+    uint16_t srcPort, destPort;
+    uint8_t protocol, tos, flags, pad;
+    uint32_t firstSeen;
+    uint32_t packetCount;  // offsets in the list
+    int64_t startSec;      // capture time of the first packet
+    int32_t startUsec;
+    uint32_t dataSize;
+};
+
+/**
+ * @class PacketIndexLookup
+ * @brief Sorted lookup table item
+ */
+struct PacketIndexLookup {
+    uint32_t srcIP, destIP;
+    uint16_t srcPort, destPort;
+    uint8_t protocol, tos;
+    uint16_t pad;
+    int64_t startSec;
+    int32_t startUsec;
+    uint32_t pad2;
+    uint64_t entryOffset;
+};
+
+/**
+ * @class PacketIndexTrailer
+ * @brief Last bytes of a completely written index file
+ */
+struct PacketIndexTrailer {
+    uint64_t lookupOffset;
+    uint64_t flowCount;
+    uint32_t magic;
+    uint32_t pad;
+};
+
+static_assert(sizeof(PacketIndexEntry) == 40, "PacketIndexEntry layout changed");
+static_assert(sizeof(PacketIndexLookup) == 40, "PacketIndexLookup layout changed");
+
+/**
+ * @brief Decodes one varint, returns the position after it
+ */
+static inline const uint8_t *decodeVarint(const uint8_t *data, const uint8_t *end, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; data < end && shift < 64; shift += 7) {
+        uint8_t byte = *data++;
+        *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return data;
+}
+
+/**
+ * @class PacketIndex
+ * @brief Collects the packet offsets of live flows and writes them when the flow is exported
+ *
+ * Each live flow owns a slot (its number is stored in the flow cache entry) holding the
+ * encoded offsets. The slots are reused after the flow is exported.
+ */
+class PacketIndex {
+   public:
+    /**
+     * @brief Constructor of the PacketIndex class
+     *
+     * @param path path of the index file
+     * @param pcapPath path of the indexed pcap file, stored in the index
+     */
+    PacketIndex(const std::string &path, const std::string &pcapPath);
+
+    ~PacketIndex();
+
+    /**
+     * @brief Checks that the pcap is a classic pcap file and creates the index file
+     *
+     * @return true if the index can be written
+     */
+    bool open();
+
+    /**
+     * @brief Allocates the slot of a new flow
+     *
+     * @param continued the flow started in an earlier file
+     * @return slot number
+     */
+    uint32_t start(bool continued);
+
+    /**
+     * @brief Appends the offset of a packet to the flow's list
+     *
+     * @param slot slot of the flow
+     * @param offset offset of the packet record in the pcap file
+     */
+    void add(uint32_t slot, uint64_t offset) {
+        Slot &s = slots[slot];
+        uint64_t delta = offset - s.lastOffset;
+        s.lastOffset = offset;
+        s.packetCount++;
+
+        uint8_t encoded[10];
+        size_t length = 0;
+        while (delta >= 0x80) {
+            encoded[length++] = static_cast<uint8_t>(delta | 0x80);
+            delta >>= 7;
+        }
+        encoded[length++] = static_cast<uint8_t>(delta);
+        s.data.insert(s.data.end(), encoded, encoded + length);
+    }
+
+    /**
+     * @brief Writes the flow into the index and releases its slot
+     *
+     * @param slot slot of the flow
+     * @param record exported record of the flow
+     * @param startTime capture time of the first packet
+     */
+    void finish(uint32_t slot, const struct NetflowRecord &record, const struct timeval &startTime);
+
+    /**
+     * @brief Writes the lookup table and the trailer and closes the file
+     *
+     * @return true if the index was written completely
+     */
+    bool close();
+
+   private:
+    struct Slot {
+        uint64_t lastOffset;
+        uint32_t packetCount;
+        bool continued;
+        std::vector<uint8_t> data;
+    };
+
+    /**
+     * @brief Writes data to the index file
+     */
+    void write(const void *data, size_t size);
+
+    std::string path;
+    std::string pcapPath;
+    FILE *file;
+    uint64_t offset;
+    bool failed;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<PacketIndexLookup> lookup;
+};
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * @file Partition.h
+ * @brief Assignment of flows to the instances of a partitioned run (--partition i/N)
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * Every instance reads the same input and keeps only the flows whose key hash maps to
+ * its partition. The hash of a key is symmetric (both directions of a connection map to
+ * the same instance) and the partition is chosen by jump consistent hashing, so changing
+ * the number of instances from N to N+1 moves only 1/(N+1) of the flows.
+ */
+
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <cstdint>
+
+#define MAX_PARTITIONS 256  // the partition index is exported as engine_id
+
+/**
+ * @brief Jump consistent hash (Lamping, Veach), maps a key to a bucket in [0, buckets)
+ */
+static inline uint32_t jumpConsistentHash(uint64_t key, uint32_t buckets) {
+    int64_t bucket = -1, next = 0;
+    while (next < static_cast<int64_t>(buckets)) {
+        bucket = next;
+        key = key * 2862933555777941757ULL + 1;
+        next = static_cast<int64_t>((bucket + 1) * (static_cast<double>(1LL << 31) / ((key >> 33) + 1)));
+    }
+    return static_cast<uint32_t>(bucket);
+}
+
+/**
+ * @class Partition
+ * @brief Partition of this instance
+ */
+struct Partition {
+    uint32_t index = 0;
+    uint32_t count = 1;
+
+    /**
+     * @brief Checks if the flow with the given key belongs to this instance
+     *
+     * @param key flow key, see FlowKey.h
+     */
+    template <class Key>
+    bool owns(const Key &key) const {
+        return jumpConsistentHash(key.partitionHash(), count) == index;
+    }
+};
+
+#endif
@@ -18,18 +18,9 @@
 #include <string>
 
 #include "FlowCache.h"
-#include "UDPExporter.h"
+#include "ExportSink.h"
 #include "Tools.h"
 
-struct PcapData {
-    uint32_t srcIP;
-    uint32_t destIP;
-    uint16_t srcPort;
-    uint16_t destPort;
-    struct timeval timeData;
-    uint8_t tcpFlags;
-};
-
 /**
  * @class PcapHandler
  * @brief PcapHandler class
@@ -40,9 +31,9 @@ class PcapHandler {
     /**
      * @brief Construct a new Pcap Handler object
      *
-     * @param pcapFile path to pcap file
+     * @param args parsed program arguments (pcap file path, state snapshots, ...)
      */
-    PcapHandler(std::string &pcapFile);
+    PcapHandler(const Arguments &args);
 
     /**
      * @brief Destroy the Pcap Handler object
@@ -61,22 +52,34 @@ class PcapHandler {
     /**
      * @brief Start the pcap handler
      *
-     * @param connection exporter
+     * @param exporter export target
      * @param timer timer object for time handling
+     * @return false if the processing could not be started
      */
-    void start(UDPExporter *connection, Timer &timer);
+    bool start(ExportSink *exporter, Timer &timer);
 
-   private:
     /**
      * @brief Proccess packet, extract important data from packet
      *
      * @param header pcap header
      * @param packet packet data
      * @param pData pcap data to be filled
-     * @return int payload size
+     * @return int payload size, -1 if the packet is skipped
+     */
+    static int proccessPacket(const struct pcap_pkthdr *header, const u_char *packet, PcapData *pData);
+
+   private:
+    /**
+     * @brief The packet loop, instantiated for every flow key and counter policy
+     *
+     * @param exporter export target
+     * @param timer timer object for time handling
+     * @return false if the processing could not be started
      */
-    int proccessPacket(const struct pcap_pkthdr *header, const u_char *packet, PcapData *pData);
+    template <class Key, class Counters>
+    bool run(ExportSink *exporter, Timer &timer);
 
+    const Arguments &args;
     std::string filePath;
     pcap_t *handle;
     char errbuf[PCAP_ERRBUF_SIZE];
@@ -0,0 +1,178 @@
+/**
+ * @file PrefixTable.h
+ * @brief Longest prefix match tables used to enrich the exported records
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#ifndef PREFIXTABLE_H
+#define PREFIXTABLE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Flow.h"
+
+/**
+ * @class RouteInfo
+ * @brief Information attached to a prefix
+ */
+struct RouteInfo {
+    uint32_t nexthop;  // network byte order
+    uint16_t as;
+    uint16_t ifIndex;
+    uint8_t mask;
+};
+
+/**
+ * @class PrefixTable
+ * @brief IPv4 longest prefix match table using the DIR-24-8 layout
+ *
+ * The first 24 bits of an address index a table of 2^24 entries. An entry either holds
+ * the route directly or points to a group of 256 entries indexed by the last 8 bits,
+ * used only where a prefix longer than /24 exists. A lookup is therefore one or two
+ * memory accesses regardless of the number of prefixes.
+ */
+class PrefixTable {
+   public:
+    /**
+     * @class Route
+     * @brief Prefix and its information, used when building the table
+     */
+    struct Route {
+        uint32_t prefix;  // host byte order
+        uint8_t length;
+        RouteInfo info;
+    };
+
+    /**
+     * @brief Builds the table from the routes, replaces previous content
+     *
+     * @param routes list of routes, for duplicate prefixes the last one wins
+     */
+    void build(std::vector<Route> routes);
+
+    /**
+     * @brief Loads the routes from a text file and builds the table
+     *
+     * Every line contains "<prefix>/<length> [<AS> [<next hop> [<interface index>]]]",
+     * empty lines and lines starting with '#' are ignored.
+     *
+     * @param path path of the file
+     * @return true if the file was read and all lines were valid
+     */
+    bool loadFile(const std::string &path);
+
+    /**
+     * @brief Finds the longest prefix matching the address
+     *
+     * @param address IPv4 address in host byte order
+     * @return information of the matching route, nullptr if there is none
+     */
+    inline const RouteInfo *find(uint32_t address) const {
+        uint32_t entry = tbl24[address >> 8];
+        if (entry & EXTENDED) {
+            entry = tbl8[((entry & ~EXTENDED) << 8) | (address & 0xff)];
+        }
+        return entry ? &routes[entry - 1] : nullptr;
+    }
+
+    /**
+     * @brief Returns number of routes in the table
+     */
+    size_t size() const;
+
+   private:
+    static constexpr uint32_t EXTENDED = 0x80000000;
+
+    std::vector<uint32_t> tbl24;
+    std::vector<uint32_t> tbl8;
+    std::vector<RouteInfo> routes;
+};
+
+/**
+ * @class PrefixEnricher
+ * @brief Fills the routing fields of exported records from a prefix table file
+ *
+ * A background thread watches the file and builds a new table when it changes. The
+ * new table is swapped in atomically, the exporting thread only checks a generation
+ * counter per record, so the packet processing is never paused by a reload.
+ */
+class PrefixEnricher {
+   public:
+    /**
+     * @brief Constructor of the enricher
+     *
+     * @param path path of the prefix table file
+     */
+    PrefixEnricher(const std::string &path);
+
+    /**
+     * @brief Destroyer, stops the reloading thread
+     */
+    ~PrefixEnricher();
+
+    /**
+     * @brief Loads the table for the first time and starts watching the file
+     *
+     * @return true if the table was loaded
+     */
+    bool start();
+
+    /**
+     * @brief Fills AS numbers, masks, next hop and interface indexes of the record
+     *
+     * @param record record with source and destination address filled
+     */
+    void enrich(struct NetflowRecord &record);
+
+   private:
+    /**
+     * @brief Main loop of the reloading thread
+     */
+    void reloadLoop();
+
+    /**
+     * @class FileVersion
+     * @brief Identifies one version of the table file, the modification time alone has
+     *        a coarse resolution and misses a rewrite within the same tick
+     */
+    struct FileVersion {
+        bool exists;
+        int64_t seconds, nanoseconds;
+        uint64_t inode, size;
+
+        bool operator==(const FileVersion &other) const {
+            return exists == other.exists && seconds == other.seconds && nanoseconds == other.nanoseconds &&
+                   inode == other.inode && size == other.size;
+        }
+    };
+
+    /**
+     * @brief Returns the version of the table file, exists is false if it cannot be read
+     */
+    FileVersion fileVersion();
+
+    std::string path;
+    FileVersion loadedVersion;
+
+    // Latest table, written by the reloading thread
+    std::mutex mutex;
+    std::shared_ptr<const PrefixTable> latest;
+    std::atomic<uint64_t> generation;
+
+    // Table used by the exporting thread
+    std::shared_ptr<const PrefixTable> active;
+    uint64_t activeGeneration;
+
+    std::condition_variable stopSignal;
+    bool stopping;
+    std::thread reloader;
+};
+
+#endif
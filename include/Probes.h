@@ -0,0 +1,105 @@
+/**
+ * @file Probes.h
+ * @brief Optional cycle histograms of the processing stages and USDT probe points
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * Everything in this file is enabled only when compiled with -DP2N_PROFILE
+ * (make PROFILE=1), otherwise the macros expand to nothing and the binary is
+ * unchanged. The USDT probes additionally require <sys/sdt.h> (systemtap-sdt-dev),
+ * they can be listed with "bpftrace -l 'usdt:./p2nprobe:*'".
+ */
+
+#ifndef PROBES_H
+#define PROBES_H
+
+#ifdef P2N_PROFILE
+
+#include <cstdint>
+#include <ostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/**
+ * @brief Measured stages of the packet processing
+ */
+enum class Stage { Decode, FlowLookup, ExpiryScan, Encode, Send, Count };
+
+/**
+ * @class StageProfiler
+ * @brief Log2 histograms of cycles spent in each stage
+ *
+ * The stages are recorded only by the packet processing thread, so the histograms
+ * are plain arrays.
+ */
+class StageProfiler {
+   public:
+    /**
+     * @brief Returns the current value of the cycle counter
+     */
+    static inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#endif
+    }
+
+    /**
+     * @brief Adds one measurement of a stage
+     */
+    static void record(Stage stage, uint64_t cycles);
+
+    /**
+     * @brief Prints count, mean and percentiles of every stage
+     */
+    static void report(std::ostream &out);
+};
+
+/**
+ * @class StageTimer
+ * @brief Measures the stage from its construction until the end of the scope
+ */
+class StageTimer {
+   public:
+    explicit StageTimer(Stage stage) : stage(stage), start(StageProfiler::now()) {}
+    ~StageTimer() { StageProfiler::record(stage, StageProfiler::now() - start); }
+
+   private:
+    Stage stage;
+    uint64_t start;
+};
+
+#define PROBE_CONCAT_(a, b) a##b
+#define PROBE_CONCAT(a, b) PROBE_CONCAT_(a, b)
+#define PROFILE_STAGE(stage) StageTimer PROBE_CONCAT(stageTimer, __LINE__)(Stage::stage)
+#define PROFILE_REPORT(out) StageProfiler::report(out)
+
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PROBE_FLOW_CREATE(srcIP, destIP, srcPort, destPort) \
+    DTRACE_PROBE4(p2nprobe, flow_create, srcIP, destIP, srcPort, destPort)
+#define PROBE_FLOW_EXPIRE(srcIP, destIP, packets, bytes) \
+    DTRACE_PROBE4(p2nprobe, flow_expire, srcIP, destIP, packets, bytes)
+#define PROBE_DATAGRAM_SEND(sequence, records, size) DTRACE_PROBE3(p2nprobe, datagram_send, sequence, records, size)
+#endif
+
+#else
+
+#define PROFILE_STAGE(stage)
+#define PROFILE_REPORT(out)
+
+#endif
+
+#ifndef PROBE_FLOW_CREATE
+#define PROBE_FLOW_CREATE(srcIP, destIP, srcPort, destPort)
+#define PROBE_FLOW_EXPIRE(srcIP, destIP, packets, bytes)
+#define PROBE_DATAGRAM_SEND(sequence, records, size)
+#endif
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * @file RateLimiter.h
+ * @brief Token bucket pacing of exported datagrams
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <time.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class RateLimiter
+ * @brief Token bucket limiting the export rate in datagrams and bytes per second
+ *
+ * Two buckets are kept, one counting datagrams and one counting bytes. Each bucket
+ * refills continuously with its rate and holds at most a burst worth of tokens, so
+ * a short burst is sent at full speed and the rest is spread evenly over time.
+ * A rate of 0 disables the corresponding bucket.
+ */
+class RateLimiter {
+   public:
+    /**
+     * @brief Constructor of the RateLimiter class
+     *
+     * @param datagramRate Maximum number of datagrams per second (0 = unlimited)
+     * @param byteRate Maximum number of bytes per second (0 = unlimited)
+     * @param burst Number of datagrams which can be sent without pacing
+     * @param maxDatagramSize Size of the biggest datagram, used for the byte bucket capacity
+     */
+    RateLimiter(uint64_t datagramRate, uint64_t byteRate, uint32_t burst, size_t maxDatagramSize);
+
+    /**
+     * @brief Blocks until a datagram of the given size may be sent and consumes its tokens
+     *
+     * @param datagramSize Size of the datagram in bytes
+     */
+    void acquire(size_t datagramSize);
+
+    /**
+     * @brief Checks if any of the buckets is enabled
+     *
+     * @return true if the export rate is limited
+     */
+    bool enabled() const;
+
+   private:
+    /**
+     * @brief Adds the tokens gained since the last refill to both buckets
+     *
+     * @param now current monotonic time in nanoseconds
+     */
+    void refill(uint64_t now);
+
+    /**
+     * @brief Returns monotonic time in nanoseconds
+     */
+    static uint64_t now();
+
+    double datagramRate, byteRate;
+    double datagramCapacity, byteCapacity;
+    double datagramTokens, byteTokens;
+    uint64_t lastRefill;
+};
+
+#endif
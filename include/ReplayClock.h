@@ -0,0 +1,92 @@
+/**
+ * @file ReplayClock.h
+ * @brief Pacing of packet ingestion by the pcap timestamps
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#ifndef REPLAYCLOCK_H
+#define REPLAYCLOCK_H
+
+#include <sys/time.h>
+
+#include <cstdint>
+#include <ostream>
+
+/**
+ * @class ReplayClock
+ * @brief Releases packets at the wall clock time given by their capture time and a speed-up factor
+ *
+ * The first packet anchors the pcap time to the wall clock. Every later packet is due at
+ * start + (capture time - first capture time) / factor. The clock sleeps with an absolute
+ * deadline until shortly before that time and spins for the rest, so the release jitter
+ * is in microseconds. When no packet is due for one second of pcap time, a tick is
+ * returned instead, so the caller can expire flows and export during idle gaps.
+ */
+class ReplayClock {
+   public:
+    /**
+     * @brief Constructor of the ReplayClock class
+     *
+     * @param factor speed-up against the capture, 1 replays in real time
+     */
+    ReplayClock(double factor);
+
+    /**
+     * @brief Waits until the packet is due or until the next idle tick
+     *
+     * @param packetTime capture time of the next packet
+     * @param tickTime pcap time of the tick, set when false is returned
+     * @return true if the packet is due, false if a tick came first (call again for the packet)
+     */
+    bool waitFor(const struct timeval &packetTime, struct timeval *tickTime);
+
+    /**
+     * @brief Returns how long the packet can wait before its release would be late
+     *
+     * @param packetTime capture time of the next packet
+     * @return nanoseconds until the packet is due, 0 or less if it is already due
+     */
+    int64_t slack(const struct timeval &packetTime) const;
+
+    /**
+     * @brief Prints how well the schedule was kept
+     *
+     * @param out output stream
+     */
+    void report(std::ostream &out) const;
+
+   private:
+    /**
+     * @brief Returns monotonic time in nanoseconds
+     */
+    static uint64_t now();
+
+    /**
+     * @brief Sleeps until shortly before the deadline and spins for the rest
+     *
+     * @param deadline monotonic time in nanoseconds
+     */
+    static void sleepUntil(uint64_t deadline);
+
+    /**
+     * @brief Returns the monotonic time at which a packet with the given capture time is due
+     */
+    uint64_t dueTime(int64_t pcapTime) const;
+
+    double factor;
+    uint64_t tickInterval;  // one second of pcap time in wall nanoseconds
+    bool started;
+    int64_t pcapStart;      // microseconds
+    int64_t pcapLast;
+    uint64_t wallStart;
+    uint64_t wallLast;
+    uint64_t nextTick;
+
+    uint64_t packets;
+    uint64_t latePackets;
+    uint64_t lagSum;
+    uint64_t lagMax;
+    uint64_t lagLast;
+};
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ * @file ShmExporter.h
+ * @brief Shared memory ring exporter header file
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#ifndef SHMEXPORTER_H
+#define SHMEXPORTER_H
+
+#include <string>
+
+#include "ExportSink.h"
+#include "ShmRing.h"
+
+/**
+ * @class ShmExporter
+ * @brief Exports the datagrams into a shared memory ring for consumers on the same host
+ *
+ * The datagrams are built directly in the ring slot, so no system call and no extra copy
+ * is needed per datagram. See ShmRing.h for the layout.
+ */
+class ShmExporter : public ExportSink {
+   public:
+    /**
+     * @brief Constructor of ShmExporter class
+     *
+     * @param name name of the shared memory object (e.g. "/p2nprobe")
+     * @param slotCount number of datagrams held by the ring, rounded up to a power of two
+     */
+    ShmExporter(const std::string &name, uint32_t slotCount);
+
+    /**
+     * @brief Destroyer of the exporter, marks the ring as closed and unmaps it
+     *
+     * The shared memory object is kept, so the readers can read the remaining datagrams.
+     */
+    ~ShmExporter() override;
+
+    /**
+     * @brief Creates the shared memory object and initializes the ring
+     *
+     * @return true if the ring was created
+     */
+    bool connect() override;
+
+   protected:
+    char *beginDatagram() override;
+    bool commitDatagram(size_t size) override;
+
+   private:
+    /**
+     * @brief Returns the slot of the given datagram number
+     */
+    ShmRingSlot *slot(uint64_t seq);
+
+    std::string name;
+    uint32_t slotCount;
+    size_t slotSize;
+    void *mapping;
+    size_t mappingSize;
+    ShmRingHeader *header;
+    uint64_t writeSeq;
+};
+
+#endif
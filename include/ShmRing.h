@@ -0,0 +1,138 @@
+/**
+ * @file ShmRing.h
+ * @brief Layout of the shared memory export ring and its reader
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * The ring lives in a POSIX shared memory object (/dev/shm/<name>) and is written by a
+ * single p2nprobe process. Any number of readers can map it read-only. The producer
+ * never waits for the readers, a reader which is too slow is overrun and detects it.
+ *
+ * Layout (all integers in host byte order, the datagrams in network byte order):
+ *
+ *   offset 0                ShmRingHeader (128 bytes)
+ *   offset 128 + i*slotSize ShmRingSlot i, i = 0 .. slotCount-1
+ *
+ * Datagram number n (counted from 0) is stored in slot n % slotCount. The slot holds
+ * a complete Netflow v5 datagram (header + up to 30 records) exactly as it would be
+ * sent over UDP, so the flowSequence field of the datagram can be used as well.
+ *
+ * Publishing datagram n:
+ *   1. slot.seq = 2n + 1           (slot is being written)
+ *   2. slot.length, slot data
+ *   3. slot.seq = 2n + 2           (release, slot holds datagram n)
+ *   4. header.writeSeq = n + 1     (release)
+ *
+ * Reading datagram n: wait until writeSeq > n, check that slot.seq == 2n + 2, copy the
+ * data and check slot.seq again. Any other value of slot.seq means the producer already
+ * reused the slot, the reader was overrun and continues with the oldest datagram still
+ * present in the ring.
+ */
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define SHM_RING_MAGIC 0x524e3250  // "P2NR"
+#define SHM_RING_VERSION 1
+#define SHM_RING_FLAG_CLOSED 0x1
+
+/**
+ * @class ShmRingHeader
+ * @brief Header at the beginning of the shared memory object
+ */
+struct ShmRingHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t slotSize;
+    uint32_t slotCount;
+    uint32_t producerPid;
+    std::atomic<uint32_t> flags;
+    uint8_t pad1[40];
+    alignas(64) std::atomic<uint64_t> writeSeq;
+    uint8_t pad2[56];
+};
+
+/**
+ * @class ShmRingSlot
+ * @brief Header of a single slot, followed by the datagram
+ */
+struct ShmRingSlot {
+    std::atomic<uint64_t> seq;
+    uint32_t length;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(ShmRingHeader) == 128, "ShmRingHeader layout changed");
+static_assert(sizeof(ShmRingSlot) == 16, "ShmRingSlot layout changed");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory ring needs lock free atomics");
+
+/**
+ * @brief Returns the size of a slot able to hold a datagram of the given size, rounded to cache lines
+ */
+constexpr size_t shmRingSlotSize(size_t datagramSize) { return (sizeof(ShmRingSlot) + datagramSize + 63) & ~size_t(63); }
+
+/**
+ * @class ShmRingReader
+ * @brief Read-only attachment to the export ring
+ */
+class ShmRingReader {
+   public:
+    /**
+     * @brief Constructor of the reader, does not attach yet
+     *
+     * @param name name of the shared memory object (e.g. "/p2nprobe")
+     */
+    ShmRingReader(const std::string &name);
+
+    /**
+     * @brief Destroyer of the reader, detaches from the ring
+     */
+    ~ShmRingReader();
+
+    /**
+     * @brief Maps the ring and positions the reader at the newest datagram
+     *
+     * @param fromOldest start with the oldest datagram still present in the ring instead
+     * @return true if the ring exists and has a known layout
+     */
+    bool attach(bool fromOldest);
+
+    /**
+     * @brief Unmaps the ring
+     */
+    void detach();
+
+    /**
+     * @brief Copies the next datagram, never blocks
+     *
+     * @param buffer destination buffer
+     * @param size size of the buffer
+     * @return size of the datagram, 0 if no new datagram is available
+     */
+    size_t read(char *buffer, size_t size);
+
+    /**
+     * @brief Returns number of datagrams lost because the reader was overrun
+     */
+    uint64_t lost() const;
+
+    /**
+     * @brief Checks if the producer has finished and all datagrams were read
+     */
+    bool finished() const;
+
+   private:
+    std::string name;
+    void *mapping;
+    size_t mappingSize;
+    const ShmRingHeader *header;
+    uint64_t cursor;
+    uint64_t lostDatagrams;
+};
+
+#endif
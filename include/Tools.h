@@ -19,6 +19,28 @@ struct Arguments {
     std::string pcap_file;
     int active_timeout = 60;
     int inactive_timeout = 60;
+    uint64_t export_rate = 0;       // datagrams per second, 0 = unlimited
+    uint64_t export_byte_rate = 0;  // bytes per second, 0 = unlimited
+    uint32_t export_burst = 1;      // datagrams sent without pacing
+    std::string shm_name;           // shared memory ring, replaces the UDP export
+    uint32_t shm_slots = 4096;
+    std::string file_path;          // binary flow file, replaces the UDP export
+    bool file_direct = false;
+    uint64_t rotate_size = 0;       // bytes, 0 = never
+    uint32_t rotate_time = 0;       // seconds, 0 = never
+    std::string load_state;         // flow cache snapshot to continue from
+    std::string save_state;         // flow cache snapshot written instead of the final flush
+    std::string prefix_table;       // prefix -> AS, mask, next hop, interface
+    std::string metrics_file;       // periodic metrics report
+    uint32_t metrics_interval = 10; // seconds between two reports
+    bool print_stats = false;       // final metrics summary on stderr
+    double replay_factor = 0;       // pace by the pcap timestamps, 0 = as fast as possible
+    std::string flow_key = "4tuple";  // 4tuple, 5tuple or pair
+    uint32_t counter_bits = 32;       // width of the flow counters, 32 or 64
+    std::string packet_index;         // per-flow packet offsets of the pcap file
+    uint32_t partition_index = 0;     // --partition i/N, also the exported engine_id
+    uint32_t partition_count = 1;
+    std::string control_socket;       // Unix socket answering queries about the flow cache
 };
 
 /**
@@ -65,13 +87,18 @@ class Timer {
      * @param firstSeenTime
      * @param lastSeenTime
      * @param currentTime
+     * @param expirationTime time of the expiration relative to the first or last packet
+     * @param activeExpired if not null, set to true when only the active timeout has expired
      * @return true if either one of the timers are expired, resulting in sending the flow, in other case false
      */
     bool checkFlowTimeouts(struct timeval firstSeenTime, struct timeval lastSeenTime, struct timeval currentTime,
-                           uint32_t *expirationTime);
+                           uint32_t *expirationTime, bool *activeExpired = nullptr);
 
     struct timeval *getStartTime();
 
+    uint32_t getActiveTimeout() const;
+    uint32_t getInactiveTimeout() const;
+
    private:
     struct timeval programStartTime;
     uint32_t activeTimeout;
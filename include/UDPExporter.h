@@ -9,18 +9,17 @@
 
 #include <netinet/in.h>
 
-#include <queue>
 #include <string>
 
-#include "Flow.h"
-#include "Tools.h"
+#include "ExportSink.h"
+#include "RateLimiter.h"
 
 /**
  * @class UDPExporter
  * @brief Interface to manage exporting individual flows via UDP
  *
  */
-class UDPExporter {
+class UDPExporter : public ExportSink {
    public:
     /**
      * @brief Constructor of UDPExporter class
@@ -34,25 +33,31 @@ class UDPExporter {
      * @brief Destroyer of the UDP Exporter
      * correctly handles closing of a socket
      */
-    ~UDPExporter();
+    ~UDPExporter() override;
 
     /**
      * @brief Function to create a socket and tries to connect to a remote port
      *
      * @return true if no problem with connecting, else false
      */
-    bool connect();
+    bool connect() override;
 
     /**
-     * @brief Function which handles exporting already expirated flows
+     * @brief Function to limit the export rate, has to be called before connect()
      *
-     * @param exportCache queue of Netflow Records
-     * @param timer Timer class instance
-     * @param sendOnlyMAX if set to true the exporter maximizes the number of flows to send up to 30, 
-     *        if there are less then 30 flows then it will not send any data
+     * @param datagramRate maximum number of datagrams per second (0 = unlimited)
+     * @param byteRate maximum number of bytes per second (0 = unlimited)
+     * @param burst number of datagrams which can be sent at once without pacing
      */
-    bool sendFlows(std::queue<struct NetflowRecord> &exportCache, Timer &timer,
-                   bool sendOnlyMAX);
+    void setPacing(uint64_t datagramRate, uint64_t byteRate, uint32_t burst);
+
+   protected:
+    char *beginDatagram() override;
+
+    /**
+     * @brief Sends the datagram to the collector, waits for the rate limiter first
+     */
+    bool commitDatagram(size_t size) override;
 
    private:
     /**
@@ -63,10 +68,13 @@ class UDPExporter {
     bool resolveHostname();
 
     struct sockaddr_in server_address;
+    RateLimiter rateLimiter;
+    uint64_t byteRate = 0;
 
     const std::string hostname;
     int port;
     int sockfd;
+    char buffer[MAX_DATAGRAM_SIZE];
 };
 
 #endif
@@ -0,0 +1,311 @@
+/**
+ * @file ControlServer.cpp
+ * @brief Control socket implementation
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#include "../include/ControlServer.h"
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+#include "../include/Metrics.h"
+
+#define CONTROL_DEFAULT_COUNT 10
+#define CONTROL_MAX_COUNT 10000  // larger N is capped, the answer stays below ~2 MB
+#define CONTROL_WAIT_MS 1000     // how long a query waits for the packet loop
+#define CONTROL_SEND_MS 2000     // how long a client may take to read the answer
+
+ControlServer::ControlServer(const std::string &path)
+    : path(path),
+      listenFd(-1),
+      requested(false),
+      stopping(false),
+      sequence(0),
+      interval(std::chrono::milliseconds(CONTROL_MIN_INTERVAL_MS)),
+      lastCopy(0) {}
+
+ControlServer::~ControlServer() {
+    stopping.store(true);
+    if (server.joinable()) {
+        server.join();
+    }
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(path.c_str());
+    }
+}
+
+bool ControlServer::start() {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: control socket path is too long: " << path << std::endl;
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+
+    // A socket left behind by a previous run would make bind fail, anything else is kept
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            std::cerr << "Error: control socket path exists and is not a socket: " << path << std::endl;
+            return false;
+        }
+        unlink(path.c_str());
+    } else if (errno != ENOENT) {
+        std::cerr << "Error checking control socket " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        std::cerr << "Error creating control socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (bind(listenFd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) < 0 ||
+        listen(listenFd, 16) < 0) {
+        std::cerr << "Error binding control socket " << path << ": " << strerror(errno) << std::endl;
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    server = std::thread(&ControlServer::serveLoop, this);
+    return true;
+}
+
+void ControlServer::publish(std::shared_ptr<FlowSnapshot> snapshot, std::chrono::steady_clock::time_point begin) {
+    auto spent = snapshot->taken - begin;
+    lastCopy = std::chrono::duration_cast<std::chrono::nanoseconds>(spent).count();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        snapshot->sequence = ++sequence;
+        current = std::move(snapshot);
+        interval = std::max<std::chrono::steady_clock::duration>(std::chrono::milliseconds(CONTROL_MIN_INTERVAL_MS),
+                                                                 spent * (100 / CONTROL_COPY_BUDGET));
+        requested.store(false, std::memory_order_relaxed);
+    }
+    published.notify_all();
+
+    Metrics::add(Metric::ControlSnapshots);
+    Metrics::add(Metric::ControlSnapshotTime,
+                 std::chrono::duration_cast<std::chrono::microseconds>(spent).count());
+}
+
+std::shared_ptr<const FlowSnapshot> ControlServer::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    if (current && now - current->taken < interval) {
+        return current;
+    }
+
+    // Ask the packet loop for a new copy, queries arriving meanwhile share it
+    uint64_t last = sequence;
+    requested.store(true, std::memory_order_relaxed);
+    published.wait_for(lock, std::chrono::milliseconds(CONTROL_WAIT_MS), [&] { return sequence != last; });
+    return current;
+}
+
+void ControlServer::serveLoop() {
+    struct pollfd listener = {listenFd, POLLIN, 0};
+
+    // Linux applies the nice value to the calling thread only
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+
+    while (!stopping.load()) {
+        // The timeout lets the thread notice the end of the run
+        if (poll(&listener, 1, 100) <= 0) continue;
+
+        int client = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) continue;
+        serve(client);
+        close(client);
+    }
+}
+
+void ControlServer::serve(int client) {
+    struct timeval timeout = {1, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::string command;
+    char buffer[256];
+    while (command.find('\n') == std::string::npos && command.size() < sizeof(buffer)) {
+        ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+        if (received <= 0) break;
+        command.append(buffer, static_cast<size_t>(received));
+    }
+    command = command.substr(0, command.find('\n'));
+
+    // A client which does not read must not hold the thread, the destructor joins it
+    std::string response = answer(command);
+    struct timeval step = {0, 100000};
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &step, sizeof(step));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(CONTROL_SEND_MS);
+    size_t sent = 0;
+    while (sent < response.size() && !stopping.load() && std::chrono::steady_clock::now() < deadline) {
+        ssize_t written = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
+        if (written <= 0) break;
+        sent += static_cast<size_t>(written);
+    }
+}
+
+/**
+ * @brief Writes an IPv4 address in network byte order as a JSON string
+ */
+static void writeAddress(std::ostream &out, uint32_t address) {
+    char text[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &address, text, sizeof(text));
+    out << '"' << text << '"';
+}
+
+/**
+ * @brief Writes one flow as a JSON object
+ */
+static void writeFlow(std::ostream &out, const FlowView &flow, int64_t captureTime) {
+    out << "{\"src\":";
+    writeAddress(out, flow.srcIP);
+    out << ",\"sport\":" << ntohs(flow.srcPort) << ",\"dst\":";
+    writeAddress(out, flow.destIP);
+    out << ",\"dport\":" << ntohs(flow.destPort) << ",\"protocol\":" << static_cast<int>(flow.protocol)
+        << ",\"tos\":" << static_cast<int>(flow.tos) << ",\"flags\":" << static_cast<int>(flow.tcpFlags)
+        << ",\"packets\":" << flow.packets << ",\"bytes\":" << flow.bytes << ",\"first_us\":" << flow.firstSeen
+        << ",\"last_us\":" << flow.lastSeen << ",\"age_ms\":" << (captureTime - flow.firstSeen) / 1000 << "}\n";
+}
+
+/**
+ * @brief Writes the N flows first in the given order
+ */
+template <class Less>
+static void writeFirst(std::ostream &out, const FlowSnapshot &snapshot, size_t count, Less less) {
+    std::vector<const FlowView *> order;
+    order.reserve(snapshot.flows.size());
+    for (const FlowView &flow : snapshot.flows) {
+        order.push_back(&flow);
+    }
+
+    count = std::min(count, order.size());
+    std::partial_sort(order.begin(), order.begin() + count, order.end(),
+                      [&](const FlowView *a, const FlowView *b) { return less(*a, *b); });
+    for (size_t i = 0; i < count; i++) {
+        writeFlow(out, *order[i], snapshot.captureTime);
+    }
+}
+
+std::string ControlServer::answer(const std::string &command) {
+    std::istringstream words(command);
+    std::string name;
+    words >> name;
+
+    // The command is checked first, a bad request must not make the packet loop copy the cache
+    size_t count = CONTROL_DEFAULT_COUNT;
+    FlowView key;
+    memset(&key, 0, sizeof(key));
+    if (name == "top" || name == "oldest" || name == "dest") {
+        std::string text;
+        if (words >> text) {
+            if (text.find_first_not_of("0123456789") != std::string::npos || text.size() > 9) {
+                return "{\"error\":\"usage: " + name + " [N]\"}\n";
+            }
+            count = std::min<size_t>(std::stoul(text), CONTROL_MAX_COUNT);
+        }
+    } else if (name == "lookup") {
+        std::string src, dst;
+        uint32_t srcPort = 0, destPort = 0;
+        if (!(words >> src >> srcPort >> dst >> destPort) || srcPort > 65535 || destPort > 65535 ||
+            inet_pton(AF_INET, src.c_str(), &key.srcIP) != 1 || inet_pton(AF_INET, dst.c_str(), &key.destIP) != 1) {
+            return "{\"error\":\"usage: lookup <src> <sport> <dst> <dport>\"}\n";
+        }
+        key.srcPort = htons(static_cast<uint16_t>(srcPort));
+        key.destPort = htons(static_cast<uint16_t>(destPort));
+    } else if (name != "summary") {
+        return "{\"error\":\"unknown command, use summary, top [N], oldest [N], dest [N] or lookup\"}\n";
+    }
+    std::string rest;
+    if (words >> rest) {
+        return "{\"error\":\"too many arguments\"}\n";
+    }
+
+    return execute(name, count, key);
+}
+
+std::string ControlServer::execute(const std::string &name, size_t count, const FlowView &key) {
+    std::ostringstream out;
+    std::shared_ptr<const FlowSnapshot> snapshot = acquire();
+    if (!snapshot) {
+        out << "{\"error\":\"no snapshot yet\"}\n";
+        return out.str();
+    }
+
+    if (name == "summary") {
+        uint64_t packets = 0, bytes = 0;
+        int64_t oldest = snapshot->captureTime;
+        for (const FlowView &flow : snapshot->flows) {
+            packets += flow.packets;
+            bytes += flow.bytes;
+            oldest = std::min(oldest, flow.firstSeen);
+        }
+        auto age = std::chrono::steady_clock::now() - snapshot->taken;
+        out << "{\"sequence\":" << snapshot->sequence
+            << ",\"snapshot_age_ms\":" << std::chrono::duration_cast<std::chrono::milliseconds>(age).count()
+            << ",\"capture_time_us\":" << snapshot->captureTime << ",\"flows\":" << snapshot->flows.size()
+            << ",\"packets\":" << packets << ",\"bytes\":" << bytes
+            << ",\"oldest_age_ms\":" << (snapshot->captureTime - oldest) / 1000 << "}\n";
+    } else if (name == "top") {
+        writeFirst(out, *snapshot, count, [](const FlowView &a, const FlowView &b) { return a.bytes > b.bytes; });
+    } else if (name == "oldest") {
+        writeFirst(out, *snapshot, count,
+                   [](const FlowView &a, const FlowView &b) { return a.firstSeen < b.firstSeen; });
+    } else if (name == "dest") {
+        struct Destination {
+            uint32_t address;
+            uint64_t flows, bytes;
+        };
+        std::unordered_map<uint32_t, Destination> destinations;
+        for (const FlowView &flow : snapshot->flows) {
+            Destination &destination = destinations[flow.destIP];
+            destination.address = flow.destIP;
+            destination.flows++;
+            destination.bytes += flow.bytes;
+        }
+
+        std::vector<Destination> order;
+        order.reserve(destinations.size());
+        for (const auto &destination : destinations) {
+            order.push_back(destination.second);
+        }
+        count = std::min(count, order.size());
+        std::partial_sort(order.begin(), order.begin() + count, order.end(),
+                          [](const Destination &a, const Destination &b) { return a.flows > b.flows; });
+        for (size_t i = 0; i < count; i++) {
+            out << "{\"dst\":";
+            writeAddress(out, order[i].address);
+            out << ",\"flows\":" << order[i].flows << ",\"bytes\":" << order[i].bytes << "}\n";
+        }
+    } else if (name == "lookup") {
+        // Keys without ports (--flow-key pair) are stored with zero ports
+        for (const FlowView &flow : snapshot->flows) {
+            if (flow.srcIP == key.srcIP && flow.destIP == key.destIP && flow.srcPort == key.srcPort &&
+                flow.destPort == key.destPort) {
+                writeFlow(out, flow, snapshot->captureTime);
+            }
+        }
+    }
+    return out.str();
+}
@@ -0,0 +1,72 @@
+/**
+ * @file ExportSink.cpp
+ * @brief Netflow v5 datagram assembly shared by all export targets
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#include "../include/ExportSink.h"
+
+#include <arpa/inet.h>
+
+#include <cstring>
+#include <tuple>
+
+#include "../include/Metrics.h"
+#include "../include/Probes.h"
+
+bool ExportSink::sendFlows(std::queue<NetflowRecord> &exportCache, Timer &timer, bool sendOnlyMAX) {
+    bool delivered = true;
+
+    while (!exportCache.empty() && (!sendOnlyMAX || exportCache.size() >= MAX_PACKETS)) {
+        PROFILE_STAGE(Send);
+        size_t totalFlows = exportCache.size();
+        if (totalFlows > MAX_PACKETS) totalFlows = MAX_PACKETS;
+
+        std::tuple<uint32_t, uint32_t, uint32_t> epochTuple = timer.getEpochTuple();
+
+        struct NetflowHeader header;
+        header.version = htons(5);
+        header.flowCount = htons(static_cast<uint16_t>(totalFlows));
+        header.sysUptime = htonl(std::get<0>(epochTuple));
+        header.unix_secs = htonl(std::get<1>(epochTuple));
+        header.unix_nsecs = htonl(std::get<2>(epochTuple));
+        header.flowSequence = htonl(flowSequence);
+        header.engine_type = 0;
+        header.engine_id = engineId;
+        header.sampling_interval = htons(0);
+
+        // calculate the totalSize and clamp it to 30 packets
+
+        size_t totalSize = sizeof(struct NetflowHeader) + sizeof(struct NetflowRecord) * totalFlows;
+
+        char *buffer = beginDatagram();
+        memcpy(buffer, &header, sizeof(struct NetflowHeader));
+        size_t currentOffset = sizeof(struct NetflowHeader);
+        for (size_t i = 0; i < totalFlows; i++) {
+            struct NetflowRecord &nflwRd = exportCache.front();
+            memcpy(buffer + currentOffset, &nflwRd, sizeof(struct NetflowRecord));
+            currentOffset += sizeof(struct NetflowRecord);
+            exportCache.pop();
+        }
+
+        if (commitDatagram(totalSize)) {
+            Metrics::add(Metric::DatagramsExported);
+            Metrics::add(Metric::RecordsExported, totalFlows);
+            PROBE_DATAGRAM_SEND(flowSequence, totalFlows, totalSize);
+        } else {
+            Metrics::add(Metric::ExportErrors);
+            delivered = false;
+        }
+
+        flowSequence += totalFlows;
+    }
+    Metrics::set(Metric::ExportQueueLength, exportCache.size());
+
+    return delivered;
+}
+
+uint32_t ExportSink::getFlowSequence() const { return flowSequence; }
+
+void ExportSink::setFlowSequence(uint32_t sequence) { flowSequence = sequence; }
+
+void ExportSink::setEngineId(uint8_t engineId) { this->engineId = engineId; }
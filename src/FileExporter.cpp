@@ -0,0 +1,317 @@
+/**
+ * @file FileExporter.cpp
+ * @brief Binary flow file exporter implementation
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#include "../include/FileExporter.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "../include/Metrics.h"
+
+#define FILE_EXPORTER_BUFFERS 8
+#define RECORDS_PER_BLOCK ((FLOW_FILE_BLOCK_SIZE - sizeof(struct FlowFileBlock)) / sizeof(struct NetflowRecord))
+
+FileExporter::FileExporter(const std::string &path, Timer &timer, bool directIO, uint64_t rotateSize,
+                           uint32_t rotateTime)
+    : path(path),
+      timer(timer),
+      directIO(directIO),
+      rotateSize(rotateSize),
+      rotateTime(rotateTime),
+      current(nullptr),
+      currentRecords(0),
+      currentFirstSequence(0),
+      currentMinFirst(UINT32_MAX),
+      currentMaxLast(0),
+      submittedBytes(FLOW_FILE_ALIGN),
+      fileStartTime(),
+      stopping(false),
+      failed(false),
+      fd(-1),
+      fileNumber(0),
+      fileOffset(0) {}
+
+FileExporter::~FileExporter() {
+    finish();
+
+    for (char *block : allBlocks) {
+        free(block);
+    }
+}
+
+bool FileExporter::finish() {
+    if (writer.joinable()) {
+        if (currentRecords > 0) {
+            submitBlock(false);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        writer.join();
+    }
+    return !failed.load();
+}
+
+bool FileExporter::connect() {
+    for (int i = 0; i < FILE_EXPORTER_BUFFERS; i++) {
+        void *block = nullptr;
+        if (posix_memalign(&block, FLOW_FILE_ALIGN, FLOW_FILE_BLOCK_SIZE) != 0) {
+            std::cerr << "Error: Could not allocate file export buffers\n";
+            return false;
+        }
+        allBlocks.push_back(static_cast<char *>(block));
+        freeBlocks.push_back(static_cast<char *>(block));
+    }
+
+    // Open the first file here, so a wrong path is reported before processing starts
+    if (!openFile()) {
+        return false;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &fileStartTime);
+    takeFreeBlock();
+    writer = std::thread(&FileExporter::writerLoop, this);
+
+    return true;
+}
+
+char *FileExporter::beginDatagram() { return datagram; }
+
+bool FileExporter::commitDatagram(size_t size) {
+    if (failed.load(std::memory_order_relaxed)) {
+        // The writer thread cannot write the file anymore
+        return false;
+    }
+
+    size_t count = (size - sizeof(struct NetflowHeader)) / sizeof(struct NetflowRecord);
+    const char *record = datagram + sizeof(struct NetflowHeader);
+
+    if (rotateTime > 0 && currentRecords > 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec - fileStartTime.tv_sec >= static_cast<time_t>(rotateTime)) {
+            submitBlock(true);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++, record += sizeof(struct NetflowRecord)) {
+        if (currentRecords == RECORDS_PER_BLOCK) {
+            submitBlock(false);
+        }
+
+        if (currentRecords == 0) {
+            currentFirstSequence = flowSequence + static_cast<uint32_t>(i);
+        }
+
+        struct NetflowRecord *stored = reinterpret_cast<struct NetflowRecord *>(
+            current + sizeof(struct FlowFileBlock) + currentRecords * sizeof(struct NetflowRecord));
+        memcpy(stored, record, sizeof(struct NetflowRecord));
+        currentRecords++;
+
+        uint32_t firstSeen = ntohl(stored->firstSeen);
+        uint32_t lastSeen = ntohl(stored->lastSeen);
+        if (firstSeen < currentMinFirst) currentMinFirst = firstSeen;
+        if (lastSeen > currentMaxLast) currentMaxLast = lastSeen;
+    }
+
+    return true;
+}
+
+void FileExporter::submitBlock(bool rotateAfter) {
+    struct FlowFileBlock blockHeader;
+    memset(&blockHeader, 0, sizeof(blockHeader));
+    blockHeader.magic = FLOW_FILE_BLOCK_MAGIC;
+    blockHeader.recordCount = currentRecords;
+    blockHeader.firstSequence = currentFirstSequence;
+    blockHeader.minFirstSeen = currentMinFirst;
+    blockHeader.maxLastSeen = currentMaxLast;
+    memcpy(current, &blockHeader, sizeof(blockHeader));
+
+    size_t used = sizeof(struct FlowFileBlock) + currentRecords * sizeof(struct NetflowRecord);
+    memset(current + used, 0, FLOW_FILE_BLOCK_SIZE - used);
+
+    // Size based rotation, the header and the index are not counted
+    submittedBytes += FLOW_FILE_BLOCK_SIZE;
+    if (rotateSize > 0 && submittedBytes + FLOW_FILE_BLOCK_SIZE > rotateSize) {
+        rotateAfter = true;
+    }
+    if (rotateAfter) {
+        submittedBytes = FLOW_FILE_ALIGN;
+        clock_gettime(CLOCK_MONOTONIC, &fileStartTime);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fullBlocks.push_back(Block{current, rotateAfter});
+    }
+    changed.notify_all();
+
+    takeFreeBlock();
+}
+
+void FileExporter::takeFreeBlock() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return !freeBlocks.empty(); });
+    current = freeBlocks.back();
+    freeBlocks.pop_back();
+
+    currentRecords = 0;
+    currentMinFirst = UINT32_MAX;
+    currentMaxLast = 0;
+}
+
+void FileExporter::writerLoop() {
+    while (true) {
+        Block block;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return stopping || !fullBlocks.empty(); });
+            if (fullBlocks.empty()) break;
+            block = fullBlocks.front();
+            fullBlocks.pop_front();
+        }
+
+        if (fd < 0 && !failed) {
+            openFile();
+        }
+
+        if (fd >= 0) {
+            const struct FlowFileBlock *blockHeader = reinterpret_cast<const struct FlowFileBlock *>(block.data);
+            if (writeAt(block.data, FLOW_FILE_BLOCK_SIZE, fileOffset)) {
+                index.push_back(FlowFileIndex{fileOffset, blockHeader->recordCount, blockHeader->minFirstSeen,
+                                              blockHeader->maxLastSeen, 0});
+                fileOffset += FLOW_FILE_BLOCK_SIZE;
+            }
+            if (block.rotateAfter) {
+                closeFile();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeBlocks.push_back(block.data);
+        }
+        changed.notify_all();
+    }
+
+    if (fd >= 0) {
+        closeFile();
+    }
+}
+
+bool FileExporter::openFile() {
+    std::string fileName = path;
+    if (rotateSize > 0 || rotateTime > 0) {
+        fileName += "." + std::to_string(fileNumber);
+    }
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    fd = -1;
+#ifdef O_DIRECT
+    if (directIO) {
+        fd = open(fileName.c_str(), flags | O_DIRECT, 0644);
+        if (fd < 0 && errno == EINVAL) {
+            // The filesystem does not support direct I/O (e.g. tmpfs)
+            std::cerr << "Warning: O_DIRECT is not supported for " << fileName << ", using buffered writes\n";
+            directIO = false;
+        }
+    }
+#endif
+    if (fd < 0) {
+        fd = open(fileName.c_str(), flags, 0644);
+    }
+    if (fd < 0) {
+        std::cerr << "Error: Could not open " << fileName << ": " << strerror(errno) << "\n";
+        failed = true;
+        return false;
+    }
+
+    // The header is padded to the alignment, so the data blocks stay aligned for O_DIRECT
+    void *buffer = nullptr;
+    if (posix_memalign(&buffer, FLOW_FILE_ALIGN, FLOW_FILE_ALIGN) != 0) {
+        close(fd);
+        fd = -1;
+        failed = true;
+        return false;
+    }
+    memset(buffer, 0, FLOW_FILE_ALIGN);
+
+    struct FlowFileHeader header;
+    header.magic = FLOW_FILE_MAGIC;
+    header.version = FLOW_FILE_VERSION;
+    header.recordSize = sizeof(struct NetflowRecord);
+    header.blockSize = FLOW_FILE_BLOCK_SIZE;
+    header.fileNumber = fileNumber;
+    header.startSec = timer.getStartTime()->tv_sec;
+    header.startUsec = timer.getStartTime()->tv_usec;
+    memcpy(buffer, &header, sizeof(header));
+
+    bool written = writeAt(static_cast<char *>(buffer), FLOW_FILE_ALIGN, 0);
+    free(buffer);
+    if (!written) {
+        close(fd);
+        fd = -1;
+        failed = true;
+        return false;
+    }
+
+    fileOffset = FLOW_FILE_ALIGN;
+    index.clear();
+    fileNumber++;
+    return true;
+}
+
+void FileExporter::closeFile() {
+    size_t indexSize = sizeof(struct FlowFileIndex) * index.size() + sizeof(struct FlowFileTrailer);
+    indexSize = (indexSize + FLOW_FILE_ALIGN - 1) / FLOW_FILE_ALIGN * FLOW_FILE_ALIGN;
+
+    void *buffer = nullptr;
+    if (posix_memalign(&buffer, FLOW_FILE_ALIGN, indexSize) == 0) {
+        memset(buffer, 0, indexSize);
+        if (!index.empty()) {
+            memcpy(buffer, index.data(), sizeof(struct FlowFileIndex) * index.size());
+        }
+
+        struct FlowFileTrailer trailer;
+        trailer.magic = FLOW_FILE_INDEX_MAGIC;
+        trailer.entryCount = static_cast<uint32_t>(index.size());
+        trailer.indexOffset = fileOffset;
+        memcpy(static_cast<char *>(buffer) + indexSize - sizeof(trailer), &trailer, sizeof(trailer));
+
+        writeAt(static_cast<char *>(buffer), indexSize, fileOffset);
+        free(buffer);
+    }
+
+    close(fd);
+    fd = -1;
+}
+
+bool FileExporter::writeAt(const char *data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            Metrics::add(Metric::ExportErrors);
+            if (!failed) {
+                std::cerr << "Error: Could not write flow file: " << strerror(errno) << "\n";
+            }
+            failed = true;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
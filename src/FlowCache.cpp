@@ -8,103 +8,390 @@
 
 #include "../include/FlowCache.h"
 
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
 #include <map>
+#include <utility>
 #include <vector>
 
-FlowCache::FlowCache(Timer &timer) : timer(timer) {}
+#include "../include/FlowState.h"
+#include "../include/Metrics.h"
+#include "../include/Probes.h"
 
-void FlowCache::handleFlow(const Flow &flow, uint32_t packetSize, struct timeval packetTime) {
-    
-    checkForExpiredFlows(packetTime);
+template <class Key, class Counters>
+BasicFlowCache<Key, Counters>::BasicFlowCache(Timer &timer)
+    : timer(timer),
+      activeTimeout(static_cast<int64_t>(timer.getActiveTimeout()) * 1000000),
+      inactiveTimeout(static_cast<int64_t>(timer.getInactiveTimeout()) * 1000000) {}
 
-    std::string flowKey = getFlowKey(flow);
+/**
+ * @brief Returns the time in microseconds
+ */
+static inline int64_t toMicroseconds(const struct timeval &time) {
+    return static_cast<int64_t>(time.tv_sec) * 1000000 + time.tv_usec;
+}
+
+/**
+ * @brief Moves a record time in milliseconds to another start time, rounded down like Timer::getTimeDifference
+ *
+ * @param uptime time relative to the old start, negative values wrap around as in the record
+ * @param shift old start minus new start in microseconds
+ */
+static inline uint32_t shiftUptime(uint32_t uptime, int64_t shift) {
+    int64_t time = static_cast<int64_t>(static_cast<int32_t>(uptime)) * 1000 + shift;
+    int64_t milliseconds = time / 1000 - (time % 1000 < 0 ? 1 : 0);
+    return static_cast<uint32_t>(milliseconds);
+}
+
+template <class Key, class Counters>
+void BasicFlowCache<Key, Counters>::handlePacket(const PcapData &packet, uint32_t packetSize) {
+
+    checkForExpiredFlows(packet.timeData);
+
+    PROFILE_STAGE(FlowLookup);
+    Key flowKey = Key::fromPacket(packet);
 
     auto it = flowCache.find(flowKey);
 
     if (it == flowCache.end()) {
         // Flow not in flowcache, create a new one
-        flowCache[flowKey] = std::make_shared<Flow>(flow);
-        flowCache[flowKey]->setFirst(packetTime, flow.tcpFlags);
-        flowCache[flowKey]->update(packetSize, packetTime);
+        Entry &flow = flowCache[flowKey];
+        flow = Entry();
+        flow.startTime = packet.timeData;
+        flow.tcpFlags = packet.tcpFlags;
+        flow.update(packetSize, packet.timeData, packet.tcpFlags);
+        if (packetIndex) {
+            flow.indexSlot = packetIndex->start(false);
+            packetIndex->add(flow.indexSlot, packet.fileOffset);
+        }
+        scheduleExpiry(flowKey, flow);
+        Metrics::add(Metric::FlowsCreated);
+        PROBE_FLOW_CREATE(packet.srcIP, packet.destIP, packet.srcPort, packet.destPort);
+        Metrics::set(Metric::FlowCacheEntries, flowCache.size());
     } else {
         // Flow is already in flowcache, update its information
-        it->second->update(packetSize, packetTime);
-        it->second->tcpFlags |= flow.tcpFlags;
+        it->second.update(packetSize, packet.timeData, packet.tcpFlags);
+        if (packetIndex) {
+            packetIndex->add(it->second.indexSlot, packet.fileOffset);
+        }
     }
 
     return;
 }
 
-void FlowCache::prepareToExport(const std::shared_ptr<Flow> &flow) {
+template <class Key, class Counters>
+void BasicFlowCache<Key, Counters>::scheduleExpiry(const Key &key, const Entry &flow) {
+    int64_t start = toMicroseconds(flow.startTime);
+    // A flow expires once the current time is past one of its deadlines (see Timer::checkFlowTimeouts)
+    int64_t deadline = std::min(start + activeTimeout, toMicroseconds(flow.lastSeenTime) + inactiveTimeout);
+    deadlines.push({deadline, start, key});
+}
+
+template <class Key, class Counters>
+void BasicFlowCache<Key, Counters>::prepareToExport(const Key &key, const Entry &flow) {
+    PROFILE_STAGE(Encode);
+
     struct NetflowRecord nfRecord;
-    nfRecord.srcIP = flow->srcIP;    // already in network order
-    nfRecord.destIP = flow->destIP;  // already in network order
+    key.toRecord(nfRecord);  // addresses and ports already in network order
     nfRecord.nexthop = htonl(0);
     nfRecord.SNMPinput = htons(0);
     nfRecord.SNMPoutput = htons(0);
-    nfRecord.totalPackets = htonl(flow->packetCount);
-    nfRecord.totalBytes = htonl(flow->byteCount);
-    nfRecord.firstSeen = htonl(timer.getTimeDifference(&(flow->startTime), timer.getStartTime()));
-    nfRecord.lastSeen = htonl(timer.getTimeDifference(&(flow->lastSeenTime), timer.getStartTime()));
-    nfRecord.srcPort = flow->srcPort;    // already in network order
-    nfRecord.destPort = flow->destPort;  // already in network order
+    nfRecord.totalPackets = htonl(flow.counters.exportPackets());
+    nfRecord.totalBytes = htonl(flow.counters.exportBytes());
+    struct timeval startTime = flow.startTime, lastSeenTime = flow.lastSeenTime;
+    nfRecord.firstSeen = htonl(timer.getTimeDifference(&startTime, timer.getStartTime()));
+    nfRecord.lastSeen = htonl(timer.getTimeDifference(&lastSeenTime, timer.getStartTime()));
     nfRecord.pad1 = 0;
-    nfRecord.TCPflags = flow->tcpFlags;
-    nfRecord.protocol = IPPROTO_TCP;
-    nfRecord.tos = 0;
+    nfRecord.TCPflags = flow.tcpFlags;
     nfRecord.srcAS = htons(0);
     nfRecord.destAS = htons(0);
     nfRecord.srcMask = 0;
     nfRecord.destMask = 0;
     nfRecord.pad2 = htons(0);
 
+    PROBE_FLOW_EXPIRE(nfRecord.srcIP, nfRecord.destIP, flow.counters.packetCount, flow.counters.byteCount);
+
+    if (enricher) {
+        enricher->enrich(nfRecord);
+    }
+    if (packetIndex) {
+        packetIndex->finish(flow.indexSlot, nfRecord, flow.startTime);
+    }
+
     exportCache.push(nfRecord);
 }
 
-void FlowCache::flushToExportAll() {
-    std::map<uint32_t, std::vector<std::shared_ptr<Flow>>> exportMap;
+template <class Key, class Counters>
+void BasicFlowCache<Key, Counters>::flushToExportAll() {
+    std::map<uint32_t, std::vector<std::pair<Key, Entry>>> exportMap;
     for (auto it = flowCache.begin(); it != flowCache.end();) {
-        exportMap[timer.getTimeDifference(&(it->second->startTime), timer.getStartTime())].push_back(it->second);
+        struct timeval startTime = it->second.startTime;
+        exportMap[timer.getTimeDifference(&startTime, timer.getStartTime())].emplace_back(it->first, it->second);
         it = flowCache.erase(it);
+        Metrics::add(Metric::FlowsFlushed);
     }
+    deadlines = decltype(deadlines)();
+    Metrics::set(Metric::FlowCacheEntries, 0);
 
     // Loop through the export map in descending order to export the flows with the oldest start time first
     for (auto it = exportMap.begin(); it != exportMap.end(); it++) {
         for (const auto &flow : it->second) {
-            prepareToExport(flow);
+            prepareToExport(flow.first, flow.second);
         }
     }
 }
 
-void FlowCache::checkForExpiredFlows(struct timeval timestamp) {
-    std::map<uint32_t, std::vector<std::shared_ptr<Flow>>> exportMap;
+template <class Key, class Counters>
+void BasicFlowCache<Key, Counters>::checkForExpiredFlows(struct timeval timestamp) {
+    int64_t now = toMicroseconds(timestamp);
+    if (deadlines.empty() || deadlines.top().time >= now) {
+        // No flow can have expired yet
+        return;
+    }
+
+    PROFILE_STAGE(ExpiryScan);
+    std::map<uint32_t, std::vector<std::pair<Key, Entry>>> exportMap;
     uint32_t expirationTime;
-    for (auto it = flowCache.begin(); it != flowCache.end();) {
-        if (timer.checkFlowTimeouts(it->second->startTime, it->second->lastSeenTime, timestamp, &expirationTime)) {
+    bool activeExpired;
+    while (!deadlines.empty() && deadlines.top().time < now) {
+        Deadline deadline = deadlines.top();
+        deadlines.pop();
+
+        auto it = flowCache.find(deadline.key);
+        if (it == flowCache.end() || toMicroseconds(it->second.startTime) != deadline.start) {
+            continue;
+        }
+        if (timer.checkFlowTimeouts(it->second.startTime, it->second.lastSeenTime, timestamp, &expirationTime,
+                                    &activeExpired)) {
             // Flow is expired, send it to export cache and remove from flow cache
-            exportMap[expirationTime].push_back(it->second);
-            it = flowCache.erase(it);
+            exportMap[expirationTime].emplace_back(it->first, it->second);
+            flowCache.erase(it);
+            Metrics::add(activeExpired ? Metric::FlowsExpiredActive : Metric::FlowsExpiredInactive);
         } else {
-            it++;
+            // The flow was updated since the deadline was computed
+            scheduleExpiry(it->first, it->second);
         }
     }
 
+    if (!exportMap.empty()) {
+        Metrics::set(Metric::FlowCacheEntries, flowCache.size());
+    }
+
     // Loop through the export map in descending order to export the flows with the biggest expiration time first
     for (auto it = exportMap.rbegin(); it != exportMap.rend(); it++) {
         for (const auto &flow : it->second) {
-            prepareToExport(flow);
+            prepareToExport(flow.first, flow.second);
         }
     }
 }
 
-bool FlowCache::exportCacheFull() { return exportCache.size() >= MAX_PACKETS ? true : false; }
+template <class Key, class Counters>
+bool BasicFlowCache<Key, Counters>::exportCacheFull() { return exportCache.size() >= MAX_PACKETS ? true : false; }
+
+template <class Key, class Counters>
+std::queue<struct NetflowRecord> &BasicFlowCache<Key, Counters>::getExportCache() { return exportCache; }
+
+template <class Key, class Counters>
+void BasicFlowCache<Key, Counters>::setEnricher(PrefixEnricher *enricher) { this->enricher = enricher; }
 
-std::string FlowCache::getFlowKey(const Flow &flow) {
-    return std::to_string(flow.srcIP) + std::to_string(flow.srcPort) + std::to_string(flow.destIP) +
-           std::to_string(flow.destPort);
+template <class Key, class Counters>
+void BasicFlowCache<Key, Counters>::setPacketIndex(PacketIndex *packetIndex) { this->packetIndex = packetIndex; }
+
+template <class Key, class Counters>
+void BasicFlowCache<Key, Counters>::snapshot(std::vector<FlowView> &flows) const {
+    flows.reserve(flowCache.size());
+    struct NetflowRecord record;
+    for (const auto &item : flowCache) {
+        const Entry &flow = item.second;
+        item.first.toRecord(record);
+
+        FlowView view;
+        view.srcIP = record.srcIP;
+        view.destIP = record.destIP;
+        view.srcPort = record.srcPort;
+        view.destPort = record.destPort;
+        view.protocol = record.protocol;
+        view.tos = record.tos;
+        view.tcpFlags = flow.tcpFlags;
+        view.packets = flow.counters.packetCount;
+        view.bytes = flow.counters.byteCount;
+        view.firstSeen = static_cast<int64_t>(flow.startTime.tv_sec) * 1000000 + flow.startTime.tv_usec;
+        view.lastSeen = static_cast<int64_t>(flow.lastSeenTime.tv_sec) * 1000000 + flow.lastSeenTime.tv_usec;
+        flows.push_back(view);
+    }
 }
 
-std::queue<struct NetflowRecord> &FlowCache::getExportCache() { return exportCache; }
 
+template <class Key, class Counters>
+bool BasicFlowCache<Key, Counters>::saveState(const std::string &path, uint32_t flowSequence) {
+    struct FlowStateHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = FLOW_STATE_MAGIC;
+    header.version = FLOW_STATE_VERSION;
+    header.entrySize = sizeof(struct FlowStateEntry);
+    header.flowCount = flowCache.size();
+    header.recordCount = exportCache.size();
+    header.flowSequence = flowSequence;
+    header.flowKey = Key::id;
+    header.counterBits = Counters::bits;
+    header.startSec = timer.getStartTime()->tv_sec;
+    header.startUsec = static_cast<int32_t>(timer.getStartTime()->tv_usec);
+
+    // The whole snapshot is built in memory and written at once
+    std::vector<char> buffer(sizeof(header) + sizeof(struct FlowStateEntry) * header.flowCount +
+                             sizeof(struct NetflowRecord) * header.recordCount);
+    memcpy(buffer.data(), &header, sizeof(header));
+
+    struct FlowStateEntry *entry = reinterpret_cast<struct FlowStateEntry *>(buffer.data() + sizeof(header));
+    for (const auto &it : flowCache) {
+        const Entry &flow = it.second;
+        memset(entry, 0, sizeof(*entry));
+        it.first.toEntry(*entry);
+        entry->tcpFlags = flow.tcpFlags;
+        entry->packetCount = flow.counters.packetCount;
+        entry->byteCount = flow.counters.byteCount;
+        entry->startSec = flow.startTime.tv_sec;
+        entry->startUsec = static_cast<int32_t>(flow.startTime.tv_usec);
+        entry->lastSeenSec = flow.lastSeenTime.tv_sec;
+        entry->lastSeenUsec = static_cast<int32_t>(flow.lastSeenTime.tv_usec);
+        entry++;
+    }
+
+    char *record = reinterpret_cast<char *>(entry);
+    for (size_t i = 0; i < header.recordCount; i++) {
+        memcpy(record, &exportCache.front(), sizeof(struct NetflowRecord));
+        exportCache.push(exportCache.front());
+        exportCache.pop();
+        record += sizeof(struct NetflowRecord);
+    }
+
+    // Write into a temporary file first, so an interrupted run never leaves a broken snapshot
+    std::string tmpPath = path + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Could not create " << tmpPath << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    const char *data = buffer.data();
+    size_t remaining = buffer.size();
+    while (remaining > 0) {
+        ssize_t written = write(fd, data, remaining);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: Could not write " << tmpPath << ": " << strerror(errno) << "\n";
+            close(fd);
+            unlink(tmpPath.c_str());
+            return false;
+        }
+        data += written;
+        remaining -= static_cast<size_t>(written);
+    }
+    close(fd);
+
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Error: Could not rename " << tmpPath << ": " << strerror(errno) << "\n";
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+template <class Key, class Counters>
+bool BasicFlowCache<Key, Counters>::loadState(const std::string &path, uint32_t *flowSequence) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(struct FlowStateHeader)) {
+        std::cerr << "Error: " << path << " is not a flow state snapshot\n";
+        close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Error: Could not map " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    // The counts are checked against the space left, so a crafted count cannot overflow the size
+    const struct FlowStateHeader *header = static_cast<const struct FlowStateHeader *>(mapping);
+    size_t body = size - sizeof(*header);
+    size_t records = 0;
+    if (header->flowCount <= body / sizeof(struct FlowStateEntry)) {
+        records = body - sizeof(struct FlowStateEntry) * header->flowCount;
+    }
+    if (header->magic != FLOW_STATE_MAGIC || header->version != FLOW_STATE_VERSION ||
+        header->entrySize != sizeof(struct FlowStateEntry) ||
+        header->flowCount > body / sizeof(struct FlowStateEntry) || records % sizeof(struct NetflowRecord) != 0 ||
+        header->recordCount != records / sizeof(struct NetflowRecord)) {
+        std::cerr << "Error: " << path << " is not a compatible flow state snapshot\n";
+        munmap(mapping, size);
+        return false;
+    }
+    if (header->flowKey != Key::id || header->counterBits != Counters::bits) {
+        std::cerr << "Error: " << path << " was written with a different --flow-key or --counters\n";
+        munmap(mapping, size);
+        return false;
+    }
+
+    // Size the table once, so loading does not rehash
+    flowCache.reserve(flowCache.size() + header->flowCount);
+
+    const struct FlowStateEntry *entry = reinterpret_cast<const struct FlowStateEntry *>(header + 1);
+    for (uint64_t i = 0; i < header->flowCount; i++, entry++) {
+        Entry flow = Entry();
+        flow.tcpFlags = entry->tcpFlags;
+        flow.counters.packetCount = static_cast<decltype(flow.counters.packetCount)>(entry->packetCount);
+        flow.counters.byteCount = static_cast<decltype(flow.counters.byteCount)>(entry->byteCount);
+        flow.startTime.tv_sec = entry->startSec;
+        flow.startTime.tv_usec = entry->startUsec;
+        flow.lastSeenTime.tv_sec = entry->lastSeenSec;
+        flow.lastSeenTime.tv_usec = entry->lastSeenUsec;
+        // The packets of the earlier file are not part of this index
+        flow.indexSlot = packetIndex ? packetIndex->start(true) : PACKET_INDEX_NO_SLOT;
+        Key key = Key::fromEntry(*entry);
+        if (flowCache.emplace(key, flow).second) {
+            scheduleExpiry(key, flow);
+        }
+    }
+
+    // The records are relative to the start of the previous run, this run sends them with its own sysUptime
+    int64_t shift = header->startSec * 1000000 + header->startUsec - toMicroseconds(*timer.getStartTime());
+    const char *record = reinterpret_cast<const char *>(entry);
+    for (uint64_t i = 0; i < header->recordCount; i++, record += sizeof(struct NetflowRecord)) {
+        struct NetflowRecord nfRecord;
+        memcpy(&nfRecord, record, sizeof(nfRecord));
+        nfRecord.firstSeen = htonl(shiftUptime(ntohl(nfRecord.firstSeen), shift));
+        nfRecord.lastSeen = htonl(shiftUptime(ntohl(nfRecord.lastSeen), shift));
+        exportCache.push(nfRecord);
+    }
+    Metrics::set(Metric::FlowCacheEntries, flowCache.size());
+
+    *flowSequence = header->flowSequence;
+    munmap(mapping, size);
+    return true;
+}
+
+template class BasicFlowCache<FourTupleKey, Counters32>;
+template class BasicFlowCache<FourTupleKey, Counters64>;
+template class BasicFlowCache<FiveTupleKey, Counters32>;
+template class BasicFlowCache<FiveTupleKey, Counters64>;
+template class BasicFlowCache<AddressPairKey, Counters32>;
+template class BasicFlowCache<AddressPairKey, Counters64>;
@@ -0,0 +1,141 @@
+/**
+ * @file Metrics.cpp
+ * @brief Runtime counters implementation
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#include "../include/Metrics.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#define METRICS_COUNT static_cast<size_t>(Metric::Count)
+
+thread_local std::atomic<uint64_t> *Metrics::block = nullptr;
+
+/**
+ * @brief Names and descriptions of the metrics, in the order of the Metric enum
+ */
+static const struct {
+    const char *name;
+    const char *help;
+    bool gauge;
+} metricInfo[METRICS_COUNT] = {
+    {"packets_seen", "Packets read from the input", false},
+    {"packets_decoded", "TCP packets passed to the flow cache", false},
+    {"packets_skipped_non_ip", "Packets skipped because they are not IPv4", false},
+    {"packets_skipped_non_tcp", "Packets skipped because they are not TCP", false},
+    {"packets_skipped_truncated", "Packets skipped because the headers were not captured", false},
+    {"packets_skipped_partition", "Packets of flows owned by another partition", false},
+    {"flows_created", "Flows created in the flow cache", false},
+    {"flows_expired_active", "Flows expired by the active timeout", false},
+    {"flows_expired_inactive", "Flows expired by the inactive timeout", false},
+    {"flows_flushed", "Flows exported at the end of the input", false},
+    {"records_exported", "Netflow records exported", false},
+    {"datagrams_exported", "Netflow datagrams exported", false},
+    {"export_errors", "Datagrams which could not be delivered", false},
+    {"control_snapshots", "Flow cache snapshots taken for the control socket", false},
+    {"control_snapshot_us", "Time the packet loop spent copying the flow cache", false},
+    {"flow_cache_entries", "Flows currently in the flow cache", true},
+    {"export_queue_length", "Expired records waiting for export", true},
+    {"replay_lag_us", "How far the replay of the last packet was behind schedule", true},
+};
+
+/**
+ * @brief Counter blocks of all threads, kept after a thread exits so its counts are not lost
+ */
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<std::atomic<uint64_t>[]>> registry;
+
+std::atomic<uint64_t> *Metrics::registerThread() {
+    std::unique_ptr<std::atomic<uint64_t>[]> counters(new std::atomic<uint64_t>[METRICS_COUNT]);
+    for (size_t i = 0; i < METRICS_COUNT; i++) {
+        counters[i].store(0, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.push_back(std::move(counters));
+    return registry.back().get();
+}
+
+void Metrics::collect(uint64_t *values) {
+    for (size_t i = 0; i < METRICS_COUNT; i++) {
+        values[i] = 0;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto &counters : registry) {
+        for (size_t i = 0; i < METRICS_COUNT; i++) {
+            values[i] += counters[i].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+std::string Metrics::toPrometheus() {
+    uint64_t values[METRICS_COUNT];
+    collect(values);
+
+    std::ostringstream out;
+    for (size_t i = 0; i < METRICS_COUNT; i++) {
+        std::string name = std::string("p2nprobe_") + metricInfo[i].name + (metricInfo[i].gauge ? "" : "_total");
+        out << "# HELP " << name << " " << metricInfo[i].help << "\n";
+        out << "# TYPE " << name << " " << (metricInfo[i].gauge ? "gauge" : "counter") << "\n";
+        out << name << " " << values[i] << "\n";
+    }
+    return out.str();
+}
+
+std::string Metrics::toJson() {
+    uint64_t values[METRICS_COUNT];
+    collect(values);
+
+    std::ostringstream out;
+    out << "{";
+    for (size_t i = 0; i < METRICS_COUNT; i++) {
+        out << (i ? ", " : "") << "\"" << metricInfo[i].name << "\": " << values[i];
+    }
+    out << "}";
+    return out.str();
+}
+
+MetricsReporter::MetricsReporter(const std::string &path, uint32_t interval)
+    : path(path), interval(interval ? interval : 1), stopping(false) {
+    json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+}
+
+MetricsReporter::~MetricsReporter() {
+    if (reporter.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        stopSignal.notify_all();
+        reporter.join();
+    }
+    write();
+}
+
+void MetricsReporter::start() { reporter = std::thread(&MetricsReporter::reportLoop, this); }
+
+void MetricsReporter::reportLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopSignal.wait_for(lock, std::chrono::seconds(interval), [this] { return stopping; })) {
+        write();
+    }
+}
+
+bool MetricsReporter::write() {
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::trunc);
+        if (!file) return false;
+        file << (json ? Metrics::toJson() + "\n" : Metrics::toPrometheus());
+        if (!file) return false;
+    }
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file PacketIndex.cpp
+ * @brief Packet offset index implementation
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#include "../include/PacketIndex.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <tuple>
+
+#define PACKET_INDEX_BUFFER (1 << 20)
+
+PacketIndex::PacketIndex(const std::string &path, const std::string &pcapPath)
+    : path(path), pcapPath(pcapPath), file(nullptr), offset(0), failed(false) {}
+
+PacketIndex::~PacketIndex() {
+    if (file) {
+        close();
+    }
+}
+
+bool PacketIndex::open() {
+    // The offsets are computed from the record lengths, which is only possible for classic pcap files
+    uint32_t magic = 0;
+    FILE *pcap = fopen(pcapPath.c_str(), "rb");
+    bool classic = pcap && fread(&magic, sizeof(magic), 1, pcap) == 1 &&
+                   (magic == 0xa1b2c3d4 || magic == 0xd4c3b2a1 || magic == 0xa1b23c4d || magic == 0x4d3cb2a1);
+    if (pcap) fclose(pcap);
+    if (!classic) {
+        std::cerr << "Error: --packet-index needs a classic pcap file (not pcapng)\n";
+        return false;
+    }
+
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error: Could not create " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    setvbuf(file, nullptr, _IOFBF, PACKET_INDEX_BUFFER);
+
+    struct PacketIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = PACKET_INDEX_MAGIC;
+    header.version = PACKET_INDEX_VERSION;
+    header.pathLength = static_cast<uint16_t>(std::min<size_t>(pcapPath.size(), UINT16_MAX));
+    write(&header, sizeof(header));
+    write(pcapPath.data(), header.pathLength);
+    return true;
+}
+
+uint32_t PacketIndex::start(bool continued) {
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(slots.size());
+        slots.emplace_back();
+    }
+
+    Slot &s = slots[slot];
+    s.lastOffset = 0;
+    s.packetCount = 0;
+    s.continued = continued;
+    s.data.clear();
+    // Most flows are short, one allocation covers them
+    s.data.reserve(32);
+    return slot;
+}
+
+void PacketIndex::write(const void *data, size_t size) {
+    if (size && fwrite(data, 1, size, file) != size) {
+        failed = true;
+    }
+    offset += size;
+}
+
+void PacketIndex::finish(uint32_t slot, const struct NetflowRecord &record, const struct timeval &startTime) {
+    Slot &s = slots[slot];
+
+    struct PacketIndexEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.srcIP = record.srcIP;
+    entry.destIP = record.destIP;
+    entry.srcPort = record.srcPort;
+    entry.destPort = record.destPort;
+    entry.protocol = record.protocol;
+    entry.tos = record.tos;
+    entry.flags = s.continued ? PACKET_INDEX_CONTINUED : 0;
+    entry.firstSeen = ntohl(record.firstSeen);
+    entry.packetCount = s.packetCount;
+    entry.startSec = startTime.tv_sec;
+    entry.startUsec = static_cast<int32_t>(startTime.tv_usec);
+    entry.dataSize = static_cast<uint32_t>(s.data.size());
+
+    struct PacketIndexLookup item;
+    memset(&item, 0, sizeof(item));
+    item.srcIP = entry.srcIP;
+    item.destIP = entry.destIP;
+    item.srcPort = entry.srcPort;
+    item.destPort = entry.destPort;
+    item.protocol = entry.protocol;
+    item.tos = entry.tos;
+    item.startSec = entry.startSec;
+    item.startUsec = entry.startUsec;
+    item.entryOffset = offset;
+    lookup.push_back(item);
+
+    write(&entry, sizeof(entry));
+    write(s.data.data(), s.data.size());
+
+    // Keep the buffer of long flows from staying allocated in a reused slot
+    if (s.data.capacity() > 4096) {
+        std::vector<uint8_t>().swap(s.data);
+    }
+    freeSlots.push_back(slot);
+}
+
+bool PacketIndex::close() {
+    if (!file) return false;
+
+    std::sort(lookup.begin(), lookup.end(), [](const PacketIndexLookup &a, const PacketIndexLookup &b) {
+        return std::tie(a.srcIP, a.destIP, a.srcPort, a.destPort, a.protocol, a.tos, a.startSec, a.startUsec) <
+               std::tie(b.srcIP, b.destIP, b.srcPort, b.destPort, b.protocol, b.tos, b.startSec, b.startUsec);
+    });
+
+    struct PacketIndexTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.lookupOffset = offset;
+    trailer.flowCount = lookup.size();
+    trailer.magic = PACKET_INDEX_MAGIC;
+    write(lookup.data(), lookup.size() * sizeof(PacketIndexLookup));
+    write(&trailer, sizeof(trailer));
+
+    if (fclose(file) != 0) failed = true;
+    file = nullptr;
+    if (failed) {
+        std::cerr << "Error: Could not write " << path << "\n";
+    }
+    return !failed;
+}
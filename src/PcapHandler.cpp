@@ -11,10 +11,19 @@
 #include <netinet/tcp.h>
 
 #include <cstring>
+#include <memory>
 
+#include "../include/ControlServer.h"
 #include "../include/Flow.h"
+#include "../include/Metrics.h"
+#include "../include/PacketIndex.h"
+#include "../include/Partition.h"
+#include "../include/Probes.h"
+#include "../include/ReplayClock.h"
 
-PcapHandler::PcapHandler(std::string &pcapFile) : filePath(pcapFile), handle(nullptr) {}
+#define TCP_FLAGS_END 14
+
+PcapHandler::PcapHandler(const Arguments &args) : args(args), filePath(args.pcap_file), handle(nullptr) {}
 
 PcapHandler::~PcapHandler() {
     if (handle) {
@@ -32,25 +41,111 @@ bool PcapHandler::openPcap() {
     return true;
 }
 
-void PcapHandler::start(UDPExporter *exporter, Timer &timer) {
+bool PcapHandler::start(ExportSink *exporter, Timer &timer) {
     if (handle == nullptr) {
         // Should not happen
         std::cerr << "Error: Pcap file is not opened\n";
-        return;
+        return false;
+    }
+
+    // The configuration is resolved once here, the packet loop itself has no runtime switches
+    bool wide = args.counter_bits == 64;
+    if (args.flow_key == "5tuple") {
+        return wide ? run<FiveTupleKey, Counters64>(exporter, timer) : run<FiveTupleKey, Counters32>(exporter, timer);
+    }
+    if (args.flow_key == "pair") {
+        return wide ? run<AddressPairKey, Counters64>(exporter, timer)
+                    : run<AddressPairKey, Counters32>(exporter, timer);
     }
+    return wide ? run<FourTupleKey, Counters64>(exporter, timer) : run<FourTupleKey, Counters32>(exporter, timer);
+}
 
-    FlowCache flowCache(timer);
+template <class Key, class Counters>
+bool PcapHandler::run(ExportSink *exporter, Timer &timer) {
+    BasicFlowCache<Key, Counters> flowCache(timer);
     PcapData pcapData;
 
+    std::unique_ptr<PrefixEnricher> enricher;
+    if (!args.prefix_table.empty()) {
+        enricher.reset(new PrefixEnricher(args.prefix_table));
+        if (!enricher->start()) {
+            return false;
+        }
+        flowCache.setEnricher(enricher.get());
+    }
+
+    std::unique_ptr<PacketIndex> packetIndex;
+    if (!args.packet_index.empty()) {
+        packetIndex.reset(new PacketIndex(args.packet_index, filePath));
+        if (!packetIndex->open()) {
+            return false;
+        }
+        flowCache.setPacketIndex(packetIndex.get());
+    }
+
     const u_char *packet;
     struct pcap_pkthdr header;
+    // Classic pcap: 24 byte file header, then a 16 byte record header before every packet
+    uint64_t fileOffset = 24;
 
     int payloadSize = 0;
 
+    Partition partition;
+    partition.index = args.partition_index;
+    partition.count = args.partition_count;
+
+    if (!args.load_state.empty()) {
+        uint32_t flowSequence = 0;
+        if (!flowCache.loadState(args.load_state, &flowSequence)) {
+            // Continuing without the state would repeat the flow sequence and lose the carried flows
+            return false;
+        }
+        exporter->setFlowSequence(flowSequence);
+    }
+
+    std::unique_ptr<ControlServer> control;
+    if (!args.control_socket.empty()) {
+        control.reset(new ControlServer(args.control_socket));
+        if (!control->start()) {
+            return false;
+        }
+    }
+
+    std::unique_ptr<ReplayClock> replay;
+    if (args.replay_factor > 0) {
+        replay.reset(new ReplayClock(args.replay_factor));
+    }
+    int64_t captureTime = 0;  // microseconds, capture time of the last packet or replay tick
+
     // The main loop of the program
     while ((packet = pcap_next(handle, &header)) != nullptr) {
+        struct timeval tickTime;
+        if (replay && control && control->wanted() && replay->slack(header.ts) > control->copyTime()) {
+            // Copied while waiting for the packet, so the copy does not delay the replay
+            control->publish(flowCache, captureTime);
+        }
+        while (replay && !replay->waitFor(header.ts, &tickTime)) {
+            // Idle gap in the capture, expire flows and export in scaled time
+            flowCache.checkForExpiredFlows(tickTime);
+            exporter->sendFlows(flowCache.getExportCache(), timer, false);
+            captureTime = static_cast<int64_t>(tickTime.tv_sec) * 1000000 + tickTime.tv_usec;
+            if (control && control->wanted() && replay->slack(header.ts) > control->copyTime()) {
+                control->publish(flowCache, captureTime);
+            }
+        }
+        captureTime = static_cast<int64_t>(header.ts.tv_sec) * 1000000 + header.ts.tv_usec;
+
+        Metrics::add(Metric::PacketsSeen);
         memset(&pcapData, 0, sizeof(struct PcapData));
         payloadSize = proccessPacket(&header, packet, &pcapData);
+        pcapData.fileOffset = fileOffset;
+        fileOffset += 16 + header.caplen;
+
+        if (payloadSize != -1 && partition.count > 1 && !partition.owns(Key::fromPacket(pcapData))) {
+            // The flow is handled by another instance
+            Metrics::add(Metric::SkippedPartition);
+            payloadSize = -1;
+        }
 
         if (payloadSize != -1) {
             if (flowCache.exportCacheFull()) {
@@ -58,48 +153,92 @@ void PcapHandler::start(UDPExporter *exporter, Timer &timer) {
                 exporter->sendFlows(flowCache.getExportCache(), timer, true);
             }
 
-            Flow flow(pcapData.srcIP, pcapData.destIP, pcapData.srcPort, pcapData.destPort, pcapData.tcpFlags);
+            flowCache.handlePacket(pcapData, static_cast<uint32_t>(payloadSize));
+        }
+
+        if (control && !replay && control->wanted()) {
+            // Copied between two packets, the queries read the copy on the control thread
+            control->publish(flowCache, captureTime);
+        }
+    }
+
+    if (replay) {
+        replay->report(std::cerr);
+    }
 
-            flowCache.handleFlow(flow, static_cast<uint32_t>(payloadSize), pcapData.timeData);
+    if (!args.save_state.empty()) {
+        // Keep the live flows and the incomplete datagram for the next run instead of exporting them
+        exporter->sendFlows(flowCache.getExportCache(), timer, true);
+        if (flowCache.saveState(args.save_state, exporter->getFlowSequence())) {
+            // The live flows are indexed in the run which exports them
+            return packetIndex ? packetIndex->close() : true;
         }
     }
 
     flowCache.flushToExportAll();
     exporter->sendFlows(flowCache.getExportCache(), timer, false);
+    return packetIndex ? packetIndex->close() : true;
 }
 
 int PcapHandler::proccessPacket(const struct pcap_pkthdr *header, const u_char *packet, PcapData *pData) {
+    PROFILE_STAGE(Decode);
     int payloadSize = -1;
 
-    const struct ether_header *eth_header = (struct ether_header *)packet;
+    if (header->caplen < sizeof(struct ether_header)) {
+        Metrics::add(Metric::SkippedTruncated);
+        return payloadSize;
+    }
 
-    if (ntohs(eth_header->ether_type) == ETHERTYPE_IP) {
-        const struct ip *ip_header = (struct ip *)(packet + sizeof(struct ether_header));
+    const struct ether_header *eth_header = (struct ether_header *)packet;
 
-        unsigned int ip_len = ip_header->ip_hl * 4;
+    if (ntohs(eth_header->ether_type) != ETHERTYPE_IP) {
+        Metrics::add(Metric::SkippedNonIP);
+        return payloadSize;
+    }
 
-        struct in_addr srcIPStruct = ip_header->ip_src;
-        struct in_addr destIPStruct = ip_header->ip_dst;
-        if (ip_header->ip_p == IPPROTO_TCP) {
-            const struct tcphdr *tcp_header = (struct tcphdr *)(packet + sizeof(struct ether_header) + ip_len);
-            struct timeval tv = header->ts;
+    if (header->caplen < sizeof(struct ether_header) + sizeof(struct ip)) {
+        Metrics::add(Metric::SkippedTruncated);
+        return payloadSize;
+    }
 
-            uint32_t srcIP = srcIPStruct.s_addr;
-            uint32_t destIP = destIPStruct.s_addr;
+    const struct ip *ip_header = (struct ip *)(packet + sizeof(struct ether_header));
 
-            uint16_t srcPort = tcp_header->source;
-            uint16_t destPort = tcp_header->dest;
-            uint8_t tcpFlags = tcp_header->th_flags;
+    unsigned int ip_len = ip_header->ip_hl * 4;
 
-            payloadSize = header->len - sizeof(struct ether_header);
+    struct in_addr srcIPStruct = ip_header->ip_src;
+    struct in_addr destIPStruct = ip_header->ip_dst;
+    if (ip_header->ip_p != IPPROTO_TCP) {
+        Metrics::add(Metric::SkippedNonTCP);
+        return payloadSize;
+    }
 
-            pData->srcIP = srcIP;
-            pData->destIP = destIP;
-            pData->srcPort = srcPort;
-            pData->destPort = destPort;
-            pData->timeData = tv;
-            pData->tcpFlags = tcpFlags;
-        }
+    // Ports and flags are within the first 14 bytes of the TCP header
+    if (header->caplen < sizeof(struct ether_header) + ip_len + TCP_FLAGS_END) {
+        Metrics::add(Metric::SkippedTruncated);
+        return payloadSize;
     }
+
+    const struct tcphdr *tcp_header = (struct tcphdr *)(packet + sizeof(struct ether_header) + ip_len);
+    struct timeval tv = header->ts;
+
+    uint32_t srcIP = srcIPStruct.s_addr;
+    uint32_t destIP = destIPStruct.s_addr;
+
+    uint16_t srcPort = tcp_header->source;
+    uint16_t destPort = tcp_header->dest;
+    uint8_t tcpFlags = tcp_header->th_flags;
+
+    payloadSize = header->len - sizeof(struct ether_header);
+
+    pData->srcIP = srcIP;
+    pData->destIP = destIP;
+    pData->srcPort = srcPort;
+    pData->destPort = destPort;
+    pData->timeData = tv;
+    pData->tcpFlags = tcpFlags;
+    pData->protocol = ip_header->ip_p;
+    pData->tos = ip_header->ip_tos;
+
+    Metrics::add(Metric::PacketsDecoded);
     return payloadSize;
 }
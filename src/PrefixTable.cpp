@@ -0,0 +1,218 @@
+/**
+ * @file PrefixTable.cpp
+ * @brief Longest prefix match tables implementation
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#include "../include/PrefixTable.h"
+
+#include <arpa/inet.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#define AS_TRANS 23456
+
+void PrefixTable::build(std::vector<Route> routeList) {
+    // Shorter prefixes are written first and longer prefixes overwrite them, the stable
+    // sort keeps the file order of duplicate prefixes
+    std::stable_sort(routeList.begin(), routeList.end(),
+                     [](const Route &a, const Route &b) { return a.length < b.length; });
+
+    tbl24.assign(1 << 24, 0);
+    tbl8.clear();
+    routes.clear();
+    routes.reserve(routeList.size());
+
+    for (const auto &route : routeList) {
+        routes.push_back(route.info);
+        uint32_t value = static_cast<uint32_t>(routes.size());
+
+        if (route.length <= 24) {
+            uint32_t first = (route.prefix >> 8) & ~((1U << (24 - route.length)) - 1);
+            std::fill(tbl24.begin() + first, tbl24.begin() + first + (1U << (24 - route.length)), value);
+            continue;
+        }
+
+        uint32_t &entry = tbl24[route.prefix >> 8];
+        if (!(entry & EXTENDED)) {
+            // Expand the /24 into a group of 256 entries inheriting the shorter prefix
+            uint32_t group = static_cast<uint32_t>(tbl8.size() >> 8);
+            tbl8.resize(tbl8.size() + 256, entry);
+            entry = group | EXTENDED;
+        }
+
+        uint32_t span = 1U << (32 - route.length);
+        uint32_t first = ((entry & ~EXTENDED) << 8) | (route.prefix & 0xff & ~(span - 1));
+        std::fill(tbl8.begin() + first, tbl8.begin() + first + span, value);
+    }
+}
+
+/**
+ * @brief Parses a decimal number, the whole text has to be the number
+ */
+static bool parseNumber(const std::string &text, uint64_t *value) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+    try {
+        *value = std::stoull(text);
+    } catch (std::exception const &ex) {
+        return false;
+    }
+    return true;
+}
+
+bool PrefixTable::loadFile(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error: Could not open prefix table " << path << "\n";
+        return false;
+    }
+
+    std::vector<Route> routeList;
+    std::string line;
+    size_t lineNumber = 0;
+
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string prefix;
+        uint64_t as = 0, ifIndex = 0;
+
+        if (!(fields >> prefix) || prefix[0] == '#') continue;
+
+        Route route;
+        size_t slash = prefix.find('/');
+        struct in_addr address;
+        uint64_t length = 32;
+        if ((slash != std::string::npos && !parseNumber(prefix.substr(slash + 1), &length)) ||
+            inet_pton(AF_INET, prefix.substr(0, slash).c_str(), &address) != 1 || length > 32) {
+            std::cerr << "Error: Invalid prefix on line " << lineNumber << " of " << path << "\n";
+            return false;
+        }
+
+        // The optional fields up to a comment, a field which is present has to be valid
+        std::string optional[3], word;
+        size_t count = 0;
+        while (fields >> word && word[0] != '#') {
+            if (count == 3) {
+                std::cerr << "Error: Unexpected field on line " << lineNumber << " of " << path << "\n";
+                return false;
+            }
+            optional[count++] = word;
+        }
+        route.info.nexthop = 0;
+        if (count > 0 && !parseNumber(optional[0], &as)) {
+            std::cerr << "Error: Invalid AS on line " << lineNumber << " of " << path << "\n";
+            return false;
+        }
+        if (count > 1 && inet_pton(AF_INET, optional[1].c_str(), &route.info.nexthop) != 1) {
+            std::cerr << "Error: Invalid next hop on line " << lineNumber << " of " << path << "\n";
+            return false;
+        }
+        if (count > 2 && !parseNumber(optional[2], &ifIndex)) {
+            std::cerr << "Error: Invalid interface on line " << lineNumber << " of " << path << "\n";
+            return false;
+        }
+
+        route.length = static_cast<uint8_t>(length);
+        route.prefix = length == 0 ? 0 : ntohl(address.s_addr) & (0xffffffffU << (32 - length));
+        route.info.as = as > UINT16_MAX ? AS_TRANS : static_cast<uint16_t>(as);
+        route.info.ifIndex = ifIndex > UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(ifIndex);
+        route.info.mask = route.length;
+        routeList.push_back(route);
+    }
+
+    build(std::move(routeList));
+    return true;
+}
+
+size_t PrefixTable::size() const { return routes.size(); }
+
+PrefixEnricher::PrefixEnricher(const std::string &path)
+    : path(path), loadedVersion{false, 0, 0, 0, 0}, generation(0), activeGeneration(0), stopping(false) {}
+
+PrefixEnricher::~PrefixEnricher() {
+    if (reloader.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        stopSignal.notify_all();
+        reloader.join();
+    }
+}
+
+PrefixEnricher::FileVersion PrefixEnricher::fileVersion() {
+    struct stat st;
+    FileVersion version = {false, 0, 0, 0, 0};
+    if (stat(path.c_str(), &st) == 0) {
+        version = {true, st.st_mtim.tv_sec, st.st_mtim.tv_nsec, st.st_ino, static_cast<uint64_t>(st.st_size)};
+    }
+    return version;
+}
+
+bool PrefixEnricher::start() {
+    loadedVersion = fileVersion();
+
+    auto table = std::make_shared<PrefixTable>();
+    if (!table->loadFile(path)) {
+        return false;
+    }
+
+    latest = table;
+    active = table;
+    generation.store(1, std::memory_order_release);
+    activeGeneration = 1;
+
+    reloader = std::thread(&PrefixEnricher::reloadLoop, this);
+    return true;
+}
+
+void PrefixEnricher::reloadLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (!stopSignal.wait_for(lock, std::chrono::seconds(1), [this] { return stopping; })) {
+        FileVersion changed = fileVersion();
+        if (!changed.exists || changed == loadedVersion) continue;
+
+        // Build the new table without holding the lock
+        lock.unlock();
+        auto table = std::make_shared<PrefixTable>();
+        bool loaded = table->loadFile(path);
+        lock.lock();
+
+        loadedVersion = changed;
+        if (loaded) {
+            latest = table;
+            generation.fetch_add(1, std::memory_order_release);
+        }
+    }
+}
+
+void PrefixEnricher::enrich(struct NetflowRecord &record) {
+    // Pick up a reloaded table, the old one is freed once the last user drops it
+    if (generation.load(std::memory_order_acquire) != activeGeneration) {
+        std::lock_guard<std::mutex> lock(mutex);
+        active = latest;
+        activeGeneration = generation.load(std::memory_order_relaxed);
+    }
+
+    const RouteInfo *src = active->find(ntohl(record.srcIP));
+    if (src) {
+        record.srcAS = htons(src->as);
+        record.srcMask = src->mask;
+        record.SNMPinput = htons(src->ifIndex);
+    }
+
+    const RouteInfo *dst = active->find(ntohl(record.destIP));
+    if (dst) {
+        record.destAS = htons(dst->as);
+        record.destMask = dst->mask;
+        record.nexthop = dst->nexthop;
+        record.SNMPoutput = htons(dst->ifIndex);
+    }
+}
@@ -0,0 +1,65 @@
+/**
+ * @file Probes.cpp
+ * @brief Stage cycle histograms, compiled only with -DP2N_PROFILE
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#include "../include/Probes.h"
+
+#ifdef P2N_PROFILE
+
+#include <chrono>
+#include <iomanip>
+
+#define HISTOGRAM_BUCKETS 64
+
+static const char *stageNames[static_cast<size_t>(Stage::Count)] = {"decode", "flow_lookup", "expiry_scan",
+                                                                     "encode", "send"};
+
+static uint64_t histogram[static_cast<size_t>(Stage::Count)][HISTOGRAM_BUCKETS];
+static uint64_t totalCycles[static_cast<size_t>(Stage::Count)];
+
+// Reference points to convert cycles to nanoseconds at the end of the run
+static const uint64_t startCycles = StageProfiler::now();
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+void StageProfiler::record(Stage stage, uint64_t cycles) {
+    size_t index = static_cast<size_t>(stage);
+    // Bucket i holds values in [2^(i-1), 2^i)
+    size_t bucket = cycles ? 64 - __builtin_clzll(cycles) : 0;
+    histogram[index][bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1]++;
+    totalCycles[index] += cycles;
+}
+
+/**
+ * @brief Returns the upper bound of the bucket containing the given percentile
+ */
+static uint64_t percentile(const uint64_t *buckets, uint64_t count, double fraction) {
+    uint64_t target = static_cast<uint64_t>(count * fraction);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen > target) return i ? (1ULL << i) - 1 : 0;
+    }
+    return UINT64_MAX;
+}
+
+void StageProfiler::report(std::ostream &out) {
+    double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+    double nsPerCycle = elapsedNs / static_cast<double>(now() - startCycles);
+
+    out << "stage          count     mean_cycles   p50<=      p90<=      p99<=      total_ms\n";
+    for (size_t stage = 0; stage < static_cast<size_t>(Stage::Count); stage++) {
+        uint64_t count = 0;
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) count += histogram[stage][i];
+        if (count == 0) continue;
+
+        out << std::left << std::setw(14) << stageNames[stage] << " " << std::setw(9) << count << " " << std::setw(13)
+            << totalCycles[stage] / count << " " << std::setw(10) << percentile(histogram[stage], count, 0.5) << " "
+            << std::setw(10) << percentile(histogram[stage], count, 0.9) << " " << std::setw(10)
+            << percentile(histogram[stage], count, 0.99) << " " << std::fixed << std::setprecision(3)
+            << totalCycles[stage] * nsPerCycle / 1e6 << "\n";
+    }
+}
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * @file RateLimiter.cpp
+ * @brief Token bucket implementation
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#include "../include/RateLimiter.h"
+
+#include <algorithm>
+#include <cerrno>
+
+RateLimiter::RateLimiter(uint64_t datagramRate, uint64_t byteRate, uint32_t burst, size_t maxDatagramSize)
+    : datagramRate(static_cast<double>(datagramRate)),
+      byteRate(static_cast<double>(byteRate)),
+      datagramCapacity(std::max<uint32_t>(burst, 1)),
+      byteCapacity(static_cast<double>(std::max<uint32_t>(burst, 1)) * maxDatagramSize),
+      datagramTokens(datagramCapacity),
+      byteTokens(byteCapacity),
+      lastRefill(now()) {}
+
+bool RateLimiter::enabled() const { return datagramRate > 0 || byteRate > 0; }
+
+uint64_t RateLimiter::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+void RateLimiter::refill(uint64_t currentTime) {
+    double elapsed = static_cast<double>(currentTime - lastRefill) / 1e9;
+    lastRefill = currentTime;
+
+    if (datagramRate > 0) {
+        datagramTokens = std::min(datagramCapacity, datagramTokens + elapsed * datagramRate);
+    }
+    if (byteRate > 0) {
+        byteTokens = std::min(byteCapacity, byteTokens + elapsed * byteRate);
+    }
+}
+
+void RateLimiter::acquire(size_t datagramSize) {
+    if (!enabled()) return;
+
+    double size = static_cast<double>(datagramSize);
+    uint64_t currentTime = now();
+    refill(currentTime);
+
+    // Compute how long it takes for both buckets to hold enough tokens
+    double wait = 0;
+    if (datagramRate > 0 && datagramTokens < 1) {
+        wait = std::max(wait, (1 - datagramTokens) / datagramRate);
+    }
+    if (byteRate > 0 && byteTokens < size) {
+        wait = std::max(wait, (size - byteTokens) / byteRate);
+    }
+
+    if (wait > 0) {
+        // Sleep until an absolute deadline, so the scheduling delay of one datagram
+        // is not added to the next one and the long term rate stays exact
+        uint64_t deadline = currentTime + static_cast<uint64_t>(wait * 1e9);
+        struct timespec ts;
+        ts.tv_sec = deadline / 1000000000ULL;
+        ts.tv_nsec = deadline % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+        }
+        refill(std::max(now(), deadline));
+    }
+
+    // Tokens may go slightly negative when the deadline rounding is hit, the debt is
+    // paid back by the next refill
+    if (datagramRate > 0) datagramTokens -= 1;
+    if (byteRate > 0) byteTokens -= size;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file ReplayClock.cpp
+ * @brief Replay scheduler implementation
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#include "../include/ReplayClock.h"
+
+#include <sys/prctl.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include "../include/Metrics.h"
+
+// Below this distance from the deadline the clock spins instead of sleeping,
+// which hides the wake-up latency of the scheduler
+#define REPLAY_SPIN_NS 50000
+// Packets released later than this count as late in the report
+#define REPLAY_LATE_NS 1000000
+
+ReplayClock::ReplayClock(double factor)
+    : factor(factor),
+      tickInterval(static_cast<uint64_t>(1e9 / factor)),
+      started(false),
+      pcapStart(0),
+      pcapLast(0),
+      wallStart(0),
+      wallLast(0),
+      nextTick(0),
+      packets(0),
+      latePackets(0),
+      lagSum(0),
+      lagMax(0),
+      lagLast(0) {
+    // The default timer slack of 50 us would eat the whole spin window
+    prctl(PR_SET_TIMERSLACK, 1UL);
+}
+
+uint64_t ReplayClock::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+void ReplayClock::sleepUntil(uint64_t deadline) {
+    if (deadline > REPLAY_SPIN_NS) {
+        uint64_t wake = deadline - REPLAY_SPIN_NS;
+        struct timespec ts;
+        ts.tv_sec = wake / 1000000000ULL;
+        ts.tv_nsec = wake % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+        }
+    }
+    while (now() < deadline) {
+    }
+}
+
+bool ReplayClock::waitFor(const struct timeval &packetTime, struct timeval *tickTime) {
+    int64_t pcapTime = static_cast<int64_t>(packetTime.tv_sec) * 1000000 + packetTime.tv_usec;
+    uint64_t current = now();
+
+    if (!started) {
+        started = true;
+        pcapStart = pcapLast = pcapTime;
+        wallStart = wallLast = current;
+        nextTick = current + tickInterval;
+        packets++;
+        return true;
+    }
+
+    // Packets out of order in the capture are released at once
+    pcapLast = std::max(pcapLast, pcapTime);
+    uint64_t due = dueTime(pcapLast);
+
+    if (current < due && nextTick < due) {
+        sleepUntil(nextTick);
+        int64_t tickPcap = pcapStart + static_cast<int64_t>((nextTick - wallStart) * factor / 1000);
+        tickTime->tv_sec = tickPcap / 1000000;
+        tickTime->tv_usec = tickPcap % 1000000;
+        nextTick += tickInterval;
+        return false;
+    }
+
+    if (current < due) {
+        sleepUntil(due);
+        // The real release time, an overslept deadline shows up as lag
+        current = now();
+    }
+
+    uint64_t lag = current - due;
+    packets++;
+    lagSum += lag;
+    lagMax = std::max(lagMax, lag);
+    lagLast = lag;
+    if (lag > REPLAY_LATE_NS) latePackets++;
+    Metrics::set(Metric::ReplayLag, lag / 1000);
+
+    wallLast = current;
+    // Ticks are only needed in idle gaps, while packets keep coming they drive the expiry
+    if (nextTick <= current) nextTick = current + tickInterval;
+    return true;
+}
+
+uint64_t ReplayClock::dueTime(int64_t pcapTime) const {
+    return wallStart + static_cast<uint64_t>((pcapTime - pcapStart) * 1000 / factor);
+}
+
+int64_t ReplayClock::slack(const struct timeval &packetTime) const {
+    if (!started) return 0;
+    int64_t pcapTime = static_cast<int64_t>(packetTime.tv_sec) * 1000000 + packetTime.tv_usec;
+    return static_cast<int64_t>(dueTime(std::max(pcapLast, pcapTime)) - now());
+}
+
+void ReplayClock::report(std::ostream &out) const {
+    double pcapSeconds = (pcapLast - pcapStart) / 1e6;
+    double wallSeconds = (wallLast - wallStart) / 1e9;
+    out << "{\"replay_factor\": " << factor << ", \"packets\": " << packets << ", \"pcap_seconds\": " << pcapSeconds
+        << ", \"wall_seconds\": " << wallSeconds
+        << ", \"achieved_factor\": " << (wallSeconds > 0 ? pcapSeconds / wallSeconds : 0)
+        << ", \"lag_max_ms\": " << lagMax / 1e6 << ", \"lag_mean_ms\": " << (packets ? lagSum / 1e6 / packets : 0)
+        << ", \"lag_final_ms\": " << lagLast / 1e6 << ", \"late_packets\": " << latePackets << "}\n";
+}
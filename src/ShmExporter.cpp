@@ -0,0 +1,105 @@
+/**
+ * @file ShmExporter.cpp
+ * @brief Shared memory ring exporter implementation
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#include "../include/ShmExporter.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+ShmExporter::ShmExporter(const std::string &name, uint32_t slotCount)
+    : name(name), slotCount(1), slotSize(shmRingSlotSize(MAX_DATAGRAM_SIZE)), mapping(nullptr), mappingSize(0),
+      header(nullptr), writeSeq(0) {
+    // Power of two slot count allows to map the sequence number to a slot with a mask
+    while (this->slotCount < slotCount && this->slotCount < (1U << 30)) {
+        this->slotCount <<= 1;
+    }
+}
+
+ShmExporter::~ShmExporter() {
+    if (mapping) {
+        header->flags.fetch_or(SHM_RING_FLAG_CLOSED, std::memory_order_release);
+        munmap(mapping, mappingSize);
+    }
+}
+
+bool ShmExporter::connect() {
+    // Start with a fresh object, readers of a previous run keep their old mapping
+    shm_unlink(name.c_str());
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Could not create shared memory object " << name << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    mappingSize = sizeof(ShmRingHeader) + slotSize * slotCount;
+    if (ftruncate(fd, static_cast<off_t>(mappingSize)) != 0) {
+        std::cerr << "Error: Could not resize shared memory object " << name << ": " << strerror(errno) << "\n";
+        close(fd);
+        return false;
+    }
+
+    mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        std::cerr << "Error: Could not map shared memory object " << name << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    // The object is zero filled, so every slot starts with seq 0 (never published)
+    header = new (mapping) ShmRingHeader();
+    header->version = SHM_RING_VERSION;
+    header->headerSize = sizeof(ShmRingHeader);
+    header->slotSize = static_cast<uint32_t>(slotSize);
+    header->slotCount = slotCount;
+    header->producerPid = static_cast<uint32_t>(getpid());
+    header->flags.store(0, std::memory_order_relaxed);
+    header->writeSeq.store(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < slotCount; i++) {
+        new (slot(i)) ShmRingSlot();
+    }
+
+    // Magic is written last, readers attaching in the meantime see an unknown layout
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHM_RING_MAGIC;
+
+    return true;
+}
+
+ShmRingSlot *ShmExporter::slot(uint64_t seq) {
+    return reinterpret_cast<ShmRingSlot *>(static_cast<char *>(mapping) + sizeof(ShmRingHeader) +
+                                           (seq & (slotCount - 1)) * slotSize);
+}
+
+char *ShmExporter::beginDatagram() {
+    ShmRingSlot *current = slot(writeSeq);
+
+    // Mark the slot as being written before its data changes
+    current->seq.store(2 * writeSeq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    return reinterpret_cast<char *>(current + 1);
+}
+
+bool ShmExporter::commitDatagram(size_t size) {
+    ShmRingSlot *current = slot(writeSeq);
+
+    current->length = static_cast<uint32_t>(size);
+    current->seq.store(2 * writeSeq + 2, std::memory_order_release);
+
+    writeSeq++;
+    header->writeSeq.store(writeSeq, std::memory_order_release);
+
+    return true;
+}
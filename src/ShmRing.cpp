@@ -0,0 +1,119 @@
+/**
+ * @file ShmRing.cpp
+ * @brief Reader of the shared memory export ring
+ * @author Jakub Gryc <xgrycj03>
+ */
+
+#include "../include/ShmRing.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+ShmRingReader::ShmRingReader(const std::string &name)
+    : name(name), mapping(nullptr), mappingSize(0), header(nullptr), cursor(0), lostDatagrams(0) {}
+
+ShmRingReader::~ShmRingReader() { detach(); }
+
+bool ShmRingReader::attach(bool fromOldest) {
+    detach();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmRingHeader)) {
+        close(fd);
+        return false;
+    }
+
+    mappingSize = static_cast<size_t>(st.st_size);
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        return false;
+    }
+
+    header = static_cast<const ShmRingHeader *>(mapping);
+    uint32_t magic = header->magic;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (magic != SHM_RING_MAGIC || header->version != SHM_RING_VERSION ||
+        header->headerSize != sizeof(ShmRingHeader) || header->slotCount == 0 ||
+        (header->slotCount & (header->slotCount - 1)) != 0 || header->slotSize <= sizeof(ShmRingSlot) ||
+        mappingSize < sizeof(ShmRingHeader) + static_cast<size_t>(header->slotSize) * header->slotCount) {
+        detach();
+        return false;
+    }
+
+    uint64_t writeSeq = header->writeSeq.load(std::memory_order_acquire);
+    cursor = writeSeq;
+    if (fromOldest) {
+        cursor = writeSeq > header->slotCount ? writeSeq - header->slotCount : 0;
+    }
+    lostDatagrams = 0;
+
+    return true;
+}
+
+void ShmRingReader::detach() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        header = nullptr;
+    }
+}
+
+size_t ShmRingReader::read(char *buffer, size_t size) {
+    if (!header) return 0;
+
+    while (true) {
+        uint64_t writeSeq = header->writeSeq.load(std::memory_order_acquire);
+        if (cursor >= writeSeq) {
+            return 0;
+        }
+
+        // Skip the datagrams which were already overwritten
+        if (writeSeq - cursor > header->slotCount) {
+            uint64_t oldest = writeSeq - header->slotCount;
+            lostDatagrams += oldest - cursor;
+            cursor = oldest;
+        }
+
+        const ShmRingSlot *slot = reinterpret_cast<const ShmRingSlot *>(
+            static_cast<const char *>(mapping) + sizeof(ShmRingHeader) +
+            (cursor & (header->slotCount - 1)) * header->slotSize);
+
+        uint64_t expected = 2 * cursor + 2;
+        uint64_t before = slot->seq.load(std::memory_order_acquire);
+        if (before == expected) {
+            size_t length = slot->length;
+            if (length > header->slotSize - sizeof(ShmRingSlot)) length = header->slotSize - sizeof(ShmRingSlot);
+            if (length > size) length = size;
+            memcpy(buffer, slot + 1, length);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot->seq.load(std::memory_order_relaxed) == expected) {
+                cursor++;
+                return length;
+            }
+        }
+
+        // The producer is already reusing the slot, the datagram is lost
+        lostDatagrams++;
+        cursor++;
+    }
+}
+
+uint64_t ShmRingReader::lost() const { return lostDatagrams; }
+
+bool ShmRingReader::finished() const {
+    if (!header) return true;
+    bool closed = header->flags.load(std::memory_order_acquire) & SHM_RING_FLAG_CLOSED;
+    return closed && cursor >= header->writeSeq.load(std::memory_order_acquire);
+}
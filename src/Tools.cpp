@@ -8,8 +8,10 @@
 
 #include <iostream>
 
+#include "../include/Partition.h"
+
 Timer::Timer(int activeTimeout, int inactiveTimeout)
-    : activeTimeout(static_cast<uint32_t>(activeTimeout)), inactiveTimeout(static_cast<uint8_t>(inactiveTimeout)) {
+    : activeTimeout(static_cast<uint32_t>(activeTimeout)), inactiveTimeout(static_cast<uint32_t>(inactiveTimeout)) {
     gettimeofday(&programStartTime, nullptr);
 }
 
@@ -56,39 +58,82 @@ uint32_t Timer::getTimeDifference(struct timeval *t1, struct timeval *t2) {
 }
 
 bool Timer::checkFlowTimeouts(struct timeval firstSeenTime, struct timeval lastSeenTime, struct timeval currentTime,
-                              uint32_t *expirationTime) {
+                              uint32_t *expirationTime, bool *activeExpired) {
     // The arguments are in milliseconds, the active and inactive timeouts are in seconds,
     // so we need to convert the timeouts to milliseconds
     int32_t expTimeActive = 0;
     int32_t expTimeInactive = 0;
-    bool expired = false;
+    bool expiredActive = false;
+    bool expiredInactive = false;
 
     // Correctly handle the expiration times
     if ((currentTime.tv_sec - firstSeenTime.tv_sec > activeTimeout) ||
         ((currentTime.tv_sec - firstSeenTime.tv_sec == activeTimeout) &&
          (currentTime.tv_usec - firstSeenTime.tv_usec > 0L))) {
-        expired = true;
+        expiredActive = true;
         expTimeActive = getTimeDifference(&currentTime, &firstSeenTime);
     }
 
     if ((currentTime.tv_sec - lastSeenTime.tv_sec > inactiveTimeout) ||
         ((currentTime.tv_sec - lastSeenTime.tv_sec == inactiveTimeout) &&
          (currentTime.tv_usec - lastSeenTime.tv_usec > 0L))) {
-        expired = true;
+        expiredInactive = true;
         expTimeInactive = getTimeDifference(&currentTime, &lastSeenTime);
     }
 
     // Handle the expiration time, if both active and inactive timeouts are expired, return the larger one
     *expirationTime =
         expTimeActive > expTimeInactive ? expTimeActive : expTimeInactive;
+    if (activeExpired) {
+        // A flow which went idle ended on its own, count it as inactive even if it is also too old
+        *activeExpired = expiredActive && !expiredInactive;
+    }
 
-    return expired;
+    return expiredActive || expiredInactive;
 }
 
 struct timeval *Timer::getStartTime() { return &programStartTime; }
 
+uint32_t Timer::getActiveTimeout() const { return activeTimeout; }
+
+uint32_t Timer::getInactiveTimeout() const { return inactiveTimeout; }
+
 void print_err() {
-    std::cerr << "Usage: ./p2nprobe <host>:<port> <pcap_file_path> [-a <active_timeout> -i <inactive_timeout>]\n";
+    std::cerr << "Usage: ./p2nprobe <host>:<port> <pcap_file_path> [-a <active_timeout> -i <inactive_timeout>]\n"
+                 "       [--rate <datagrams/s>] [--byte-rate <bytes/s>] [--burst <datagrams>]\n"
+                 "   or: ./p2nprobe --shm <name> <pcap_file_path> [--shm-slots <datagrams>] [-a ... -i ...]\n"
+                 "   or: ./p2nprobe --file <path> <pcap_file_path> [--file-direct] [--rotate-size <MB>]\n"
+                 "       [--rotate-time <seconds>] [-a ... -i ...]\n"
+                 "   common: [--load-state <file>] [--save-state <file>] [--prefixes <file>]\n"
+                 "           [--metrics <file>] [--metrics-interval <seconds>] [--stats]\n"
+                 "           [--replay[=<factor>]] [--flow-key 4tuple|5tuple|pair] [--counters 32|64]\n"
+                 "           [--packet-index <file>] [--partition <i>/<N>]\n"
+                 "           [--control <socket>]\n";
+}
+
+/**
+ * @brief Parses the numeric value of an option, advances the argument index
+ *
+ * @return true if the value is present and is a non-negative number
+ */
+static bool parse_option_value(int argc, char *argv[], int *i, uint64_t *value) {
+    if (*i + 1 >= argc) {
+        return false;
+    }
+    std::string str = argv[++(*i)];
+    try {
+        size_t pos = 0;
+        long long number = std::stoll(str, &pos);
+        if (pos != str.size() || number < 0) {
+            std::cerr << "Invalid value of " << argv[*i - 1] << ": " << str << "\n";
+            return false;
+        }
+        *value = static_cast<uint64_t>(number);
+    } catch (std::exception const &ex) {
+        std::cerr << "Invalid value of " << argv[*i - 1] << ": " << str << "\n";
+        return false;
+    }
+    return true;
 }
 
 bool parse_arguments(int argc, char *argv[], Arguments *args) {
@@ -100,12 +145,162 @@ bool parse_arguments(int argc, char *argv[], Arguments *args) {
 
     bool parsed_hostname = false;
     bool parsed_pcap_file = false;
+    bool parsed_pacing = false;
     int timeout = 60;
+    uint64_t value = 0;
     std::string current_arg;
 
     for (int i = 1; i < argc; i++) {
         current_arg = argv[i];
 
+        if (current_arg == "--rate" || current_arg == "--byte-rate" || current_arg == "--burst") {
+            if (!parse_option_value(argc, argv, &i, &value)) return false;
+            parsed_pacing = true;
+
+            if (current_arg == "--rate") {
+                args->export_rate = value;
+            } else if (current_arg == "--byte-rate") {
+                args->export_byte_rate = value;
+            } else {
+                if (value == 0 || value > UINT32_MAX) return false;
+                args->export_burst = static_cast<uint32_t>(value);
+            }
+            continue;
+        }
+
+        if (current_arg == "--shm") {
+            if (i + 1 >= argc) return false;
+            args->shm_name = argv[++i];
+            // shm_open expects a single leading slash
+            if (args->shm_name.empty() || args->shm_name.find('/', 1) != std::string::npos) return false;
+            if (args->shm_name[0] != '/') args->shm_name = "/" + args->shm_name;
+            continue;
+        }
+
+        if (current_arg == "--shm-slots") {
+            if (!parse_option_value(argc, argv, &i, &value)) return false;
+            if (value == 0 || value > (1U << 30)) return false;
+            args->shm_slots = static_cast<uint32_t>(value);
+            continue;
+        }
+
+        if (current_arg == "--file") {
+            if (i + 1 >= argc) return false;
+            args->file_path = argv[++i];
+            continue;
+        }
+
+        if (current_arg == "--metrics") {
+            if (i + 1 >= argc) return false;
+            args->metrics_file = argv[++i];
+            continue;
+        }
+
+        if (current_arg == "--metrics-interval") {
+            if (!parse_option_value(argc, argv, &i, &value)) return false;
+            if (value == 0 || value > UINT32_MAX) return false;
+            args->metrics_interval = static_cast<uint32_t>(value);
+            continue;
+        }
+
+        if (current_arg == "--stats") {
+            args->print_stats = true;
+            continue;
+        }
+
+        if (current_arg == "--prefixes") {
+            if (i + 1 >= argc) return false;
+            args->prefix_table = argv[++i];
+            continue;
+        }
+
+        if (current_arg == "--load-state" || current_arg == "--save-state") {
+            if (i + 1 >= argc) return false;
+            (current_arg == "--load-state" ? args->load_state : args->save_state) = argv[++i];
+            continue;
+        }
+
+        if (current_arg.compare(0, 8, "--replay") == 0) {
+            if (current_arg == "--replay") {
+                args->replay_factor = 1;
+                continue;
+            }
+            if (current_arg[8] != '=') return false;
+            try {
+                size_t pos = 0;
+                args->replay_factor = std::stod(current_arg.substr(9), &pos);
+                if (pos != current_arg.size() - 9) return false;
+            } catch (std::exception const &ex) {
+                return false;
+            }
+            if (!(args->replay_factor > 0)) return false;
+            continue;
+        }
+
+        if (current_arg == "--partition") {
+            if (i + 1 >= argc) return false;
+            std::string partition = argv[++i];
+            size_t slash = partition.find('/');
+            try {
+                size_t pos = 0;
+                if (slash == std::string::npos) return false;
+                args->partition_index = static_cast<uint32_t>(std::stoul(partition.substr(0, slash), &pos));
+                if (pos != slash) return false;
+                args->partition_count = static_cast<uint32_t>(std::stoul(partition.substr(slash + 1), &pos));
+                if (pos != partition.size() - slash - 1) return false;
+            } catch (std::exception const &ex) {
+                return false;
+            }
+            if (args->partition_count == 0 || args->partition_count > MAX_PARTITIONS ||
+                args->partition_index >= args->partition_count) {
+                return false;
+            }
+            continue;
+        }
+
+        if (current_arg == "--control") {
+            if (i + 1 >= argc) return false;
+            args->control_socket = argv[++i];
+            continue;
+        }
+
+        if (current_arg == "--packet-index") {
+            if (i + 1 >= argc) return false;
+            args->packet_index = argv[++i];
+            continue;
+        }
+
+        if (current_arg == "--flow-key") {
+            if (i + 1 >= argc) return false;
+            args->flow_key = argv[++i];
+            if (args->flow_key != "4tuple" && args->flow_key != "5tuple" && args->flow_key != "pair") return false;
+            continue;
+        }
+
+        if (current_arg == "--counters") {
+            if (!parse_option_value(argc, argv, &i, &value)) return false;
+            if (value != 32 && value != 64) return false;
+            args->counter_bits = static_cast<uint32_t>(value);
+            continue;
+        }
+
+        if (current_arg == "--file-direct") {
+            args->file_direct = true;
+            continue;
+        }
+
+        if (current_arg == "--rotate-size" || current_arg == "--rotate-time") {
+            if (!parse_option_value(argc, argv, &i, &value)) return false;
+            if (current_arg == "--rotate-size") {
+                if (value > UINT64_MAX / (1024 * 1024)) return false;
+                args->rotate_size = value * 1024 * 1024;
+            } else {
+                if (value > UINT32_MAX) return false;
+                args->rotate_time = static_cast<uint32_t>(value);
+            }
+            continue;
+        }
+
         size_t colonPos = current_arg.find(':');
         if (colonPos != std::string::npos) {
             args->hostname = current_arg.substr(0, colonPos);
@@ -131,7 +326,20 @@ bool parse_arguments(int argc, char *argv[], Arguments *args) {
         }
     }
 
-    if (!parsed_hostname || !parsed_pcap_file) return false;
+    if (!parsed_pcap_file) return false;
+
+    // Exactly one export target has to be given
+    int targets = parsed_hostname + !args->shm_name.empty() + !args->file_path.empty();
+    if (targets != 1) {
+        if (targets > 1) std::cerr << "Only one export target can be given\n";
+        return false;
+    }
+
+    // Only the UDP export is paced, the local sinks would ignore the limits
+    if (parsed_pacing && !parsed_hostname) {
+        std::cerr << "--rate, --byte-rate and --burst can only be used with the UDP export\n";
+        return false;
+    }
 
     return true;
 }
@@ -10,7 +10,8 @@
 #include <cstring>
 #include <iostream>
 
-UDPExporter::UDPExporter(const std::string hostname, int port) : hostname(hostname), port(port), sockfd(-1) {
+UDPExporter::UDPExporter(const std::string hostname, int port)
+    : rateLimiter(0, 0, 0, 0), hostname(hostname), port(port), sockfd(-1) {
     memset(&server_address, 0, sizeof(server_address));
 }
 
@@ -54,55 +55,30 @@ bool UDPExporter::connect() {
         return false;
     }
 
+#ifdef SO_MAX_PACING_RATE
+    if (byteRate > 0) {
+        // Let the kernel pace the socket as well (effective with the fq qdisc), the token
+        // bucket below still enforces the limit when the kernel ignores the option
+        uint32_t pacingRate = byteRate > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(byteRate);
+        setsockopt(sockfd, SOL_SOCKET, SO_MAX_PACING_RATE, &pacingRate, sizeof(pacingRate));
+    }
+#endif
+
     return true;
 }
 
-bool UDPExporter::sendFlows(std::queue<NetflowRecord> &exportCache, Timer &timer,
-                            bool sendOnlyMAX) {
-    static uint32_t flowSequence = 0;
-
-    while (!exportCache.empty() && (!sendOnlyMAX || exportCache.size() >= MAX_PACKETS)) {
-        size_t totalFlows = exportCache.size();
-        if (totalFlows > MAX_PACKETS) totalFlows = MAX_PACKETS;
-
-        std::tuple<uint32_t, uint32_t, uint32_t> epochTuple = timer.getEpochTuple();
-
-        struct NetflowHeader header;
-        header.version = htons(5);
-        header.flowCount = htons(static_cast<uint16_t>(totalFlows));
-        header.sysUptime = htonl(std::get<0>(epochTuple));
-        header.unix_secs = htonl(std::get<1>(epochTuple));
-        header.unix_nsecs = htonl(std::get<2>(epochTuple));
-        header.flowSequence = htonl(flowSequence);
-        header.engine_type = 0;
-        header.engine_id = 0;
-        header.sampling_interval = htons(0);
-
-        // calculate the totalSize and clamp it to 30 packets
-
-        size_t totalSize = sizeof(struct NetflowHeader) + sizeof(struct NetflowRecord) * totalFlows;
-
-        char *buffer = new char[totalSize];
-        memcpy(buffer, &header, sizeof(struct NetflowHeader));
-        size_t currentOffset = sizeof(struct NetflowHeader);
-        for (size_t i = 0; i < totalFlows; i++) {
-            struct NetflowRecord &nflwRd = exportCache.front();
-            memcpy(buffer + currentOffset, &nflwRd, sizeof(struct NetflowRecord));
-            currentOffset += sizeof(struct NetflowRecord);
-            exportCache.pop();
-        }
-
-        ssize_t bytes_tx =
-            sendto(sockfd, buffer, totalSize, 0, (struct sockaddr *)(&server_address), sizeof(server_address));
+void UDPExporter::setPacing(uint64_t datagramRate, uint64_t byteRate, uint32_t burst) {
+    this->byteRate = byteRate;
+    rateLimiter = RateLimiter(datagramRate, byteRate, burst, MAX_DATAGRAM_SIZE);
+}
 
-        if (bytes_tx < 0) {
-        }
+char *UDPExporter::beginDatagram() { return buffer; }
 
-        flowSequence += totalFlows;
+bool UDPExporter::commitDatagram(size_t size) {
+    rateLimiter.acquire(size);
 
-        delete[] buffer;
-    }
+    ssize_t bytes_tx =
+        sendto(sockfd, buffer, size, 0, (struct sockaddr *)(&server_address), sizeof(server_address));
 
-    return true;
+    return bytes_tx >= 0;
 }
-
@@ -7,8 +7,13 @@
 #include <sys/socket.h>
 
 #include <iostream>
+#include <memory>
 
+#include "../include/FileExporter.h"
+#include "../include/Metrics.h"
 #include "../include/PcapHandler.h"
+#include "../include/Probes.h"
+#include "../include/ShmExporter.h"
 #include "../include/Tools.h"
 #include "../include/UDPExporter.h"
 
@@ -19,24 +24,56 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    UDPExporter *exporter = new UDPExporter(args.hostname, args.port);
-    
     // Create a timer object with the active and inactive timeout values
     // Upon creation, the timer will calculate the current time to be used as the start time
     Timer timer(args.active_timeout, args.inactive_timeout);
 
+    ExportSink *exporter;
+    if (!args.shm_name.empty()) {
+        exporter = new ShmExporter(args.shm_name, args.shm_slots);
+    } else if (!args.file_path.empty()) {
+        exporter = new FileExporter(args.file_path, timer, args.file_direct, args.rotate_size, args.rotate_time);
+    } else {
+        UDPExporter *udpExporter = new UDPExporter(args.hostname, args.port);
+        udpExporter->setPacing(args.export_rate, args.export_byte_rate, args.export_burst);
+        exporter = udpExporter;
+    }
+    exporter->setEngineId(static_cast<uint8_t>(args.partition_index));
+
 
     if (!exporter->connect()) {
-        std::cerr << "Unable to connect to: " << args.hostname << ":" << args.port << std::endl;
+        if (!args.hostname.empty()) {
+            std::cerr << "Unable to connect to: " << args.hostname << ":" << args.port << std::endl;
+        }
+        delete exporter;
         return EXIT_FAILURE;
     }
 
-    PcapHandler pcap_handler(args.pcap_file);
+    std::unique_ptr<MetricsReporter> reporter;
+    if (!args.metrics_file.empty()) {
+        reporter.reset(new MetricsReporter(args.metrics_file, args.metrics_interval));
+        reporter->start();
+    }
+
+    PcapHandler pcap_handler(args);
 
-    pcap_handler.openPcap();
-    pcap_handler.start(exporter, timer);
+    int result = 0;
+    if (!pcap_handler.openPcap() || !pcap_handler.start(exporter, timer)) {
+        result = EXIT_FAILURE;
+    }
 
+    // The file exporter writes in the background, its errors are known after it finishes
+    if (!exporter->finish()) {
+        std::cerr << "Error: Not all flows could be exported\n";
+        result = EXIT_FAILURE;
+    }
     delete exporter;
+    reporter.reset();
+
+    if (args.print_stats) {
+        std::cerr << Metrics::toJson() << std::endl;
+    }
+    PROFILE_REPORT(std::cerr);
 
-    return 0;
+    return result;
 }
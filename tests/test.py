@@ -10,6 +10,8 @@ import sys
 import subprocess
 import time
 import threading
+import ipaddress
+import tempfile
 # import numpy as np
 from datetime import datetime
 from zoneinfo import ZoneInfo
@@ -21,6 +23,7 @@ CREATE_JSON = False
 RUN_TESTS = False
 RUN_SOFTFLOWD = False
 RUN_DURATION_TEST = False
+RUN_PREFIX_TEST = False
 
 
 EXPORTER_EXEC = "../p2nprobe"
@@ -40,6 +43,7 @@ Usage: python3 test.py [OPTIONS]
 [OPTIONS]:
 -c               Create JSON files with the exported data
 -d | --duration  Run duration tests to test active duration of your flows
+-p | --prefixes  Run tests of the --prefixes file parser
 -t | --test      Run tests on the exported data with softflowd (not reliable on bigger pcaps)
 --softflowd      Create JSON outputs with softflowd
 -a [ACTIVE]      Set active timeout in seconds
@@ -501,11 +505,114 @@ def run_duration_tests():
 
     print(colored(f"\n\nTotal successful tests: {total_success}/{num_of_tests}", "light_magenta"))
 
+# Comments after any field are allowed, each line gives the prefix, AS, next hop and interface
+PREFIX_TABLE = """# full line comment
+0.0.0.0/1 # after the prefix
+128.0.0.0/1 65001 # after the AS
+147.229.0.0/16 65002 10.0.0.1 # after the next hop
+192.168.0.0/16 65003 10.0.0.2 7 # after the interface
+162.159.0.0/16 65004 10.0.0.3 8
+"""
+
+# Every line has to make the exporter refuse the file
+PREFIX_INVALID = [
+    "10.0.0.0/8abc",
+    "10.0.0.0/",
+    "10.0.0.0/33",
+    "10.0.0/8",
+    "10.0.0.0/8 65000x",
+    "10.0.0.0/8 65000 10.0.0",
+    "10.0.0.0/8 65000 10.0.0.1 7x",
+    "10.0.0.0/8 65000 10.0.0.1 7 extra",
+]
+
+
+def write_prefix_file(content):
+    """Write a prefix table into a temporary file and return its path."""
+    with tempfile.NamedTemporaryFile("w", suffix=".txt", delete=False) as prefix_file:
+        prefix_file.write(content)
+    return prefix_file.name
+
+
+def prefix_lookup(address):
+    """Longest prefix match over PREFIX_TABLE, returns (AS, next hop, interface, mask)."""
+    best = (0, "0.0.0.0", 0, 0)
+    for line in PREFIX_TABLE.splitlines():
+        fields = line.split("#")[0].split()
+        if not fields:
+            continue
+        network = ipaddress.ip_network(fields[0])
+        if ipaddress.ip_address(address) in network and network.prefixlen >= best[3]:
+            best = (int(fields[1]) if len(fields) > 1 else 0, fields[2] if len(fields) > 2 else "0.0.0.0",
+                    int(fields[3]) if len(fields) > 3 else 0, network.prefixlen)
+    return best
+
+
+def run_prefix_tests():
+    """
+    Run the exporter with prefix tables, checks that comments are accepted after any field
+    and that the enriched records match, and that every malformed line rejects the file
+    """
+    global stop_thread
+    global total_success
+    pcap_file = PCAP_DIR / "test2.pcap"
+    num_of_tests = 1 + len(PREFIX_INVALID)
+
+    print("\n\n")
+    print("****************************************")
+    print("*        RUNNING PREFIX TESTS          *")
+    print("****************************************")
+
+    print(colored(f"\nRunning test: prefix table with comments", "yellow"))
+    path = write_prefix_file(PREFIX_TABLE)
+    stop_thread = False
+    collector_process = run_collector()
+    time.sleep(0.4)
+    exporter_process = subprocess.run(
+        [EXPORTER_EXEC, "127.0.0.1:9995", str(pcap_file), "--prefixes", path], capture_output=True, text=True
+    )
+    time.sleep(0.4)
+    stop_thread = True
+    collector_process.join()
+    os.unlink(path)
+
+    records = list(message_data["records"].values())
+    mismatches = []
+    for record in records:
+        src_as, _, src_if, src_mask = prefix_lookup(record["SrcAddr"])
+        dst_as, nexthop, dst_if, dst_mask = prefix_lookup(record["DstAddr"])
+        if (record["SrcAS"], record["Input"], record["SrcMask"], record["DstAS"], record["NextHop"],
+                record["Output"], record["DstMask"]) != (src_as, src_if, src_mask, dst_as, nexthop, dst_if, dst_mask):
+            mismatches.append(record)
+    if exporter_process.returncode != 0 or not records:
+        log_failure(f"Exporter refused a valid prefix table: {exporter_process.stderr.strip()}")
+    elif mismatches:
+        log_failure(f"{len(mismatches)} of {len(records)} records are enriched wrongly, first: {mismatches[0]}")
+    else:
+        log_success("SUCCESS")
+        total_success += 1
+
+    for line in PREFIX_INVALID:
+        print(colored(f"\nRunning test: invalid line '{line}'", "yellow"))
+        path = write_prefix_file(line + "\n")
+        exporter_process = subprocess.run(
+            [EXPORTER_EXEC, "127.0.0.1:9995", str(pcap_file), "--prefixes", path], capture_output=True, text=True
+        )
+        os.unlink(path)
+        if exporter_process.returncode == 0:
+            log_failure("Exporter accepted the file")
+        else:
+            log_success("SUCCESS")
+            total_success += 1
+
+    print(colored(f"\n\nTotal successful tests: {total_success}/{num_of_tests}", "light_magenta"))
+
 def main():
 
     create_output() if CREATE_JSON else True
     run_tests() if (RUN_TESTS and RUN_SOFTFLOWD) else True
     run_duration_tests() if RUN_DURATION_TEST else True
+    run_prefix_tests() if RUN_PREFIX_TEST else True
 
 
 
@@ -525,6 +632,10 @@ if __name__ == "__main__":
     if "-d" in sys.argv or "--duration" in sys.argv:
         RUN_DURATION_TEST = True
 
+    # run tests of the prefix table parser
+    if "-p" in sys.argv or "--prefixes" in sys.argv:
+        RUN_PREFIX_TEST = True
+
     if "-h" in sys.argv or "--help" in sys.argv:
         print_help()
         exit(0)
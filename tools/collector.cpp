@@ -0,0 +1,246 @@
+/**
+ * @file collector.cpp
+ * @brief Minimal NetFlow v5 collector for end-to-end tests and benchmarks
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * Usage: ./collector [-p <port>] [-o <dump>] [--idle <ms>] [--rcvbuf <bytes>]
+ *
+ * Receives datagrams in batches with recvmmsg, checks the header of every datagram and
+ * the continuity of flowSequence per engine (engine_type, engine_id), and stops after
+ * --idle milliseconds without data once the first datagram arrived (or on SIGINT).
+ * The summary is printed as one JSON object on stdout. With -o the records are written
+ * sorted, one JSON object per line, without the timestamps, so two runs can be compared
+ * with diff. The layout differs from the test logs in tests/logs.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "../include/Flow.h"
+
+#define BATCH_SIZE 64
+#define DATAGRAM_BUFFER 2048
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void handle_signal(int) { stopRequested = 1; }
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @class EngineState
+ * @brief Sequence tracking of one exporter engine
+ */
+struct EngineState {
+    uint32_t expected = 0;
+    uint64_t datagrams = 0;
+    uint64_t records = 0;
+    uint64_t lost = 0;
+    uint64_t outOfOrder = 0;
+};
+
+/**
+ * @brief Key used to sort records in the dump
+ */
+static std::tuple<uint32_t, uint32_t, uint16_t, uint16_t, uint32_t, uint32_t> sortKey(const NetflowRecord &r) {
+    return std::make_tuple(ntohl(r.srcIP), ntohl(r.destIP), ntohs(r.srcPort), ntohs(r.destPort), ntohl(r.firstSeen),
+                           ntohl(r.totalPackets));
+}
+
+static std::string address(uint32_t networkOrder) {
+    char buffer[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &networkOrder, buffer, sizeof(buffer));
+    return buffer;
+}
+
+static void writeDump(std::vector<NetflowRecord> &records, const std::string &path) {
+    std::sort(records.begin(), records.end(),
+              [](const NetflowRecord &a, const NetflowRecord &b) { return sortKey(a) < sortKey(b); });
+
+    std::ofstream out(path);
+    for (const NetflowRecord &r : records) {
+        out << "{\"SrcAddr\": \"" << address(r.srcIP) << "\", \"DstAddr\": \"" << address(r.destIP)
+            << "\", \"NextHop\": \"" << address(r.nexthop) << "\", \"Input\": " << ntohs(r.SNMPinput)
+            << ", \"Output\": " << ntohs(r.SNMPoutput) << ", \"Packets\": " << ntohl(r.totalPackets)
+            << ", \"Octets\": " << ntohl(r.totalBytes) << ", \"Duration\": " << ntohl(r.lastSeen) - ntohl(r.firstSeen)
+            << ", \"SrcPort\": " << ntohs(r.srcPort) << ", \"DstPort\": " << ntohs(r.destPort)
+            << ", \"TCPFlags\": " << static_cast<int>(r.TCPflags) << ", \"Protocol\": " << static_cast<int>(r.protocol)
+            << ", \"Tos\": " << static_cast<int>(r.tos) << ", \"SrcAS\": " << ntohs(r.srcAS)
+            << ", \"DstAS\": " << ntohs(r.destAS) << ", \"SrcMask\": " << static_cast<int>(r.srcMask)
+            << ", \"DstMask\": " << static_cast<int>(r.destMask) << "}\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    uint16_t port = 2055;
+    std::string dumpPath;
+    int idleMs = 2000;
+    int rcvbuf = 64 << 20;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc || (arg != "-p" && arg != "-o" && arg != "--idle" && arg != "--rcvbuf")) {
+            std::cerr << "Usage: ./collector [-p <port>] [-o <dump>] [--idle <ms>] [--rcvbuf <bytes>]\n";
+            return EXIT_FAILURE;
+        }
+        std::string value = argv[++i];
+        if (arg == "-p") port = static_cast<uint16_t>(std::stoul(value));
+        else if (arg == "-o") dumpPath = value;
+        else if (arg == "--idle") idleMs = std::stoi(value);
+        else rcvbuf = std::stoi(value);
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        std::cerr << "Error: Could not create the socket\n";
+        return EXIT_FAILURE;
+    }
+    // SO_RCVBUFFORCE ignores rmem_max but needs CAP_NET_ADMIN
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) != 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "Error: Could not bind port " << port << "\n";
+        return EXIT_FAILURE;
+    }
+
+    int actualBuffer = 0;
+    socklen_t optionLength = sizeof(actualBuffer);
+    getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &actualBuffer, &optionLength);
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    std::vector<char> buffers(BATCH_SIZE * DATAGRAM_BUFFER);
+    std::vector<char> controls(BATCH_SIZE * CMSG_SPACE(sizeof(uint32_t)));
+    struct mmsghdr messages[BATCH_SIZE];
+    struct iovec iovecs[BATCH_SIZE];
+
+    std::map<uint16_t, EngineState> engines;
+    std::vector<NetflowRecord> records;
+    uint64_t datagrams = 0, recordCount = 0, malformed = 0;
+    uint32_t kernelDrops = 0;
+    double firstTime = 0, lastTime = 0;
+
+    while (!stopRequested) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, datagrams ? idleMs : 1000);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0) {
+            if (datagrams) break;
+            continue;
+        }
+
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            iovecs[i].iov_base = buffers.data() + i * DATAGRAM_BUFFER;
+            iovecs[i].iov_len = DATAGRAM_BUFFER;
+            memset(&messages[i].msg_hdr, 0, sizeof(messages[i].msg_hdr));
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            messages[i].msg_hdr.msg_control = controls.data() + i * CMSG_SPACE(sizeof(uint32_t));
+            messages[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint32_t));
+        }
+
+        int received = recvmmsg(fd, messages, BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        if (received <= 0) continue;
+
+        double t = now();
+        if (!datagrams) firstTime = t;
+        lastTime = t;
+
+        for (int i = 0; i < received; i++) {
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&messages[i].msg_hdr); cmsg;
+                 cmsg = CMSG_NXTHDR(&messages[i].msg_hdr, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                    memcpy(&kernelDrops, CMSG_DATA(cmsg), sizeof(kernelDrops));
+                }
+            }
+
+            const char *data = static_cast<const char *>(iovecs[i].iov_base);
+            size_t length = messages[i].msg_len;
+            datagrams++;
+
+            struct NetflowHeader header;
+            if (length < sizeof(header)) {
+                malformed++;
+                continue;
+            }
+            memcpy(&header, data, sizeof(header));
+            uint16_t count = ntohs(header.flowCount);
+            if (ntohs(header.version) != 5 || count > 30 ||
+                length != sizeof(header) + count * sizeof(struct NetflowRecord)) {
+                malformed++;
+                continue;
+            }
+
+            uint32_t sequence = ntohl(header.flowSequence);
+            EngineState &engine = engines[static_cast<uint16_t>(header.engine_type << 8 | header.engine_id)];
+            if (engine.datagrams && sequence != engine.expected) {
+                // Signed distance, so that a wrap of the 32-bit counter is not a loss
+                int32_t distance = static_cast<int32_t>(sequence - engine.expected);
+                if (distance > 0) engine.lost += distance;
+                else engine.outOfOrder++;
+            }
+            if (!engine.datagrams || static_cast<int32_t>(sequence + count - engine.expected) > 0) {
+                engine.expected = sequence + count;
+            }
+            engine.datagrams++;
+            engine.records += count;
+            recordCount += count;
+
+            if (!dumpPath.empty()) {
+                for (uint16_t r = 0; r < count; r++) {
+                    NetflowRecord record;
+                    memcpy(&record, data + sizeof(header) + r * sizeof(record), sizeof(record));
+                    records.push_back(record);
+                }
+            }
+        }
+    }
+    close(fd);
+
+    if (!dumpPath.empty()) writeDump(records, dumpPath);
+
+    uint64_t lost = 0, outOfOrder = 0;
+    for (const auto &engine : engines) {
+        lost += engine.second.lost;
+        outOfOrder += engine.second.outOfOrder;
+    }
+    double seconds = lastTime - firstTime;
+
+    std::cout << "{\"datagrams\": " << datagrams << ", \"records\": " << recordCount << ", \"lost_records\": " << lost
+              << ", \"out_of_order\": " << outOfOrder << ", \"malformed\": " << malformed
+              << ", \"kernel_drops\": " << kernelDrops << ", \"engines\": " << engines.size()
+              << ", \"rcvbuf\": " << actualBuffer << ", \"seconds\": " << seconds << ", \"records_per_sec\": "
+              << (seconds > 0 ? recordCount / seconds : 0) << ", \"datagrams_per_sec\": "
+              << (seconds > 0 ? datagrams / seconds : 0) << "}\n";
+
+    return (lost || malformed || kernelDrops) ? 2 : 0;
+}
@@ -0,0 +1,238 @@
+/**
+ * @file flow_extract.cpp
+ * @brief Lists the flows of a packet index or extracts the packets of a flow to a new pcap
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * Usage: ./flow_extract <index>
+ *        ./flow_extract <index> <src_ip> <src_port> <dst_ip> <dst_port> -o <out.pcap> [-f <first_seen>] [-p <pcap>]
+ *
+ * Without a flow key all indexed flows are listed. With a key the packets of all flows
+ * with that key (or only the one whose exported firstSeen matches -f) are copied from
+ * the pcap into a new pcap, reading only those packets. The pcap path stored in the
+ * index can be replaced with -p.
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "../include/PacketIndex.h"
+
+/**
+ * @brief Reads exactly size bytes at the given offset
+ */
+static bool readAt(int fd, void *buffer, size_t size, uint64_t offset) {
+    return pread(fd, buffer, size, static_cast<off_t>(offset)) == static_cast<ssize_t>(size);
+}
+
+static std::string address(uint32_t networkOrder) {
+    char buffer[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &networkOrder, buffer, sizeof(buffer));
+    return buffer;
+}
+
+/**
+ * @brief Copies the packets at the given offsets into a new pcap file
+ */
+static bool extract(const std::string &pcapPath, const std::string &outPath, std::vector<uint64_t> &offsets) {
+    int in = open(pcapPath.c_str(), O_RDONLY);
+    if (in < 0) {
+        std::cerr << "Error: Could not open " << pcapPath << "\n";
+        return false;
+    }
+    FILE *out = fopen(outPath.c_str(), "wb");
+    if (!out) {
+        std::cerr << "Error: Could not create " << outPath << "\n";
+        close(in);
+        return false;
+    }
+
+    uint8_t fileHeader[24];
+    bool ok = readAt(in, fileHeader, sizeof(fileHeader), 0) && fwrite(fileHeader, sizeof(fileHeader), 1, out) == 1;
+    uint32_t magic;
+    memcpy(&magic, fileHeader, sizeof(magic));
+    bool swapped = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+
+    std::sort(offsets.begin(), offsets.end());
+    std::vector<uint8_t> packet;
+    for (uint64_t offset : offsets) {
+        if (!ok) break;
+        uint8_t recordHeader[16];
+        uint32_t caplen;
+        ok = readAt(in, recordHeader, sizeof(recordHeader), offset);
+        memcpy(&caplen, recordHeader + 8, sizeof(caplen));
+        if (swapped) caplen = __builtin_bswap32(caplen);
+        if (!ok || caplen > (1U << 26)) {
+            std::cerr << "Error: " << pcapPath << " does not match the index\n";
+            ok = false;
+            break;
+        }
+        packet.resize(caplen);
+        ok = readAt(in, packet.data(), caplen, offset + sizeof(recordHeader)) &&
+             fwrite(recordHeader, sizeof(recordHeader), 1, out) == 1 &&
+             (caplen == 0 || fwrite(packet.data(), caplen, 1, out) == 1);
+    }
+
+    close(in);
+    if (fclose(out) != 0) ok = false;
+    return ok;
+}
+
+/**
+ * @brief Copies the entry at the given offset, false if the entry or its offset list
+ *        does not lie between the pcap path and the lookup table
+ */
+static bool readEntry(const uint8_t *data, uint64_t begin, uint64_t end, uint64_t offset,
+                      struct PacketIndexEntry *entry) {
+    if (offset < begin || offset > end || end - offset < sizeof(*entry)) return false;
+    memcpy(entry, data + offset, sizeof(*entry));
+    return entry->dataSize <= end - offset - sizeof(*entry);
+}
+
+/**
+ * @brief Lists or extracts the flows of a mapped index, returns the exit code
+ */
+static int query(const uint8_t *data, size_t size, int argc, char *argv[]) {
+    auto started = std::chrono::steady_clock::now();
+    struct PacketIndexHeader header;
+    struct PacketIndexTrailer trailer;
+    memcpy(&header, data, sizeof(header));
+    memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+
+    // Entries lie between the path and the lookup table, which fills the rest up to the trailer
+    uint64_t entriesBegin = sizeof(header) + header.pathLength;
+    uint64_t tableSpace = size - sizeof(trailer);
+    if (header.magic != PACKET_INDEX_MAGIC || header.version != PACKET_INDEX_VERSION ||
+        trailer.magic != PACKET_INDEX_MAGIC || trailer.lookupOffset < entriesBegin ||
+        trailer.lookupOffset > tableSpace || (tableSpace - trailer.lookupOffset) % sizeof(PacketIndexLookup) != 0 ||
+        trailer.flowCount != (tableSpace - trailer.lookupOffset) / sizeof(PacketIndexLookup)) {
+        std::cerr << "Error: " << argv[1] << " is not a complete packet index\n";
+        return EXIT_FAILURE;
+    }
+    const PacketIndexLookup *table = reinterpret_cast<const PacketIndexLookup *>(data + trailer.lookupOffset);
+    const PacketIndexLookup *tableEnd = table + trailer.flowCount;
+    std::string pcapPath(reinterpret_cast<const char *>(data + sizeof(header)), header.pathLength);
+
+    if (argc == 2) {
+        for (const PacketIndexLookup *item = table; item != tableEnd; item++) {
+            struct PacketIndexEntry entry;
+            if (!readEntry(data, entriesBegin, trailer.lookupOffset, item->entryOffset, &entry)) {
+                std::cerr << "Error: " << argv[1] << " is corrupt\n";
+                return EXIT_FAILURE;
+            }
+            std::cout << address(entry.srcIP) << ":" << ntohs(entry.srcPort) << " -> " << address(entry.destIP)
+                      << ":" << ntohs(entry.destPort) << " first " << entry.firstSeen << " packets "
+                      << entry.packetCount << (entry.flags & PACKET_INDEX_CONTINUED ? " continued" : "") << "\n";
+        }
+        return 0;
+    }
+
+    PacketIndexLookup key;
+    memset(&key, 0, sizeof(key));
+    std::string outPath;
+    long long firstSeen = -1;
+    try {
+        if (inet_pton(AF_INET, argv[2], &key.srcIP) != 1 || inet_pton(AF_INET, argv[4], &key.destIP) != 1) {
+            throw std::invalid_argument("address");
+        }
+        key.srcPort = htons(static_cast<uint16_t>(std::stoul(argv[3])));
+        key.destPort = htons(static_cast<uint16_t>(std::stoul(argv[5])));
+        for (int i = 6; i + 1 < argc; i += 2) {
+            std::string option = argv[i];
+            if (option == "-o") outPath = argv[i + 1];
+            else if (option == "-f") firstSeen = std::stoll(argv[i + 1]);
+            else if (option == "-p") pcapPath = argv[i + 1];
+            else throw std::invalid_argument(option);
+        }
+    } catch (std::exception const &ex) {
+        std::cerr << "Error: Invalid flow key or option\n";
+        return EXIT_FAILURE;
+    }
+    if (outPath.empty()) {
+        std::cerr << "Error: Missing -o <out.pcap>\n";
+        return EXIT_FAILURE;
+    }
+
+    // The table is sorted by the key first, so all flows with the key are next to each other
+    auto byKey = [](const PacketIndexLookup &a, const PacketIndexLookup &b) {
+        return std::tie(a.srcIP, a.destIP, a.srcPort, a.destPort) < std::tie(b.srcIP, b.destIP, b.srcPort, b.destPort);
+    };
+    auto range = std::equal_range(table, tableEnd, key, byKey);
+
+    std::vector<uint64_t> offsets;
+    size_t flows = 0;
+    for (const PacketIndexLookup *item = range.first; item != range.second; item++) {
+        struct PacketIndexEntry entry;
+        if (!readEntry(data, entriesBegin, trailer.lookupOffset, item->entryOffset, &entry)) {
+            std::cerr << "Error: " << argv[1] << " is corrupt\n";
+            return EXIT_FAILURE;
+        }
+        if (firstSeen >= 0 && entry.firstSeen != static_cast<uint64_t>(firstSeen)) continue;
+
+        const uint8_t *list = data + item->entryOffset + sizeof(entry);
+        const uint8_t *listEnd = list + entry.dataSize;
+        uint64_t offset = 0, delta;
+        for (uint32_t i = 0; i < entry.packetCount && list < listEnd; i++) {
+            list = decodeVarint(list, listEnd, &delta);
+            offset += delta;
+            offsets.push_back(offset);
+        }
+        flows++;
+    }
+
+    if (flows == 0) {
+        std::cerr << "Error: The flow is not in the index\n";
+        return EXIT_FAILURE;
+    }
+    if (!extract(pcapPath, outPath, offsets)) {
+        return EXIT_FAILURE;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    std::cerr << "Extracted " << offsets.size() << " packets of " << flows << " flow(s) in " << ms << " ms\n";
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2 && argc < 8) {
+        std::cerr << "Usage: ./flow_extract <index>\n"
+                     "       ./flow_extract <index> <src_ip> <src_port> <dst_ip> <dst_port> -o <out.pcap> "
+                     "[-f <first_seen>] [-p <pcap>]\n";
+        return EXIT_FAILURE;
+    }
+
+    int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        std::cerr << "Error: Could not open " << argv[1] << "\n";
+        if (fd >= 0) close(fd);
+        return EXIT_FAILURE;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size < sizeof(PacketIndexHeader) + sizeof(PacketIndexTrailer)) {
+        std::cerr << "Error: " << argv[1] << " is not a packet index\n";
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Error: Could not map " << argv[1] << "\n";
+        return EXIT_FAILURE;
+    }
+
+    int status = query(static_cast<const uint8_t *>(mapping), size, argc, argv);
+    munmap(mapping, size);
+    return status;
+}
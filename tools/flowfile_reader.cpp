@@ -0,0 +1,118 @@
+/**
+ * @file flowfile_reader.cpp
+ * @brief Prints records of a binary flow file written with --file
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * Usage: ./flowfile_reader <file> [<from_ms> <to_ms>]
+ * With a time range only the blocks overlapping it are read, using the block index.
+ * Times are milliseconds since the exporter start, as in the firstSeen/lastSeen fields.
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../include/Flow.h"
+#include "../include/FlowFile.h"
+
+/**
+ * @brief Reads exactly size bytes at the given offset
+ */
+static bool readAt(int fd, void *buffer, size_t size, uint64_t offset) {
+    return pread(fd, buffer, size, static_cast<off_t>(offset)) == static_cast<ssize_t>(size);
+}
+
+/**
+ * @brief Prints the records of one block which overlap the time range
+ */
+static uint64_t printBlock(const std::vector<char> &block, uint32_t from, uint32_t to) {
+    struct FlowFileBlock blockHeader;
+    memcpy(&blockHeader, block.data(), sizeof(blockHeader));
+    if (blockHeader.magic != FLOW_FILE_BLOCK_MAGIC) return 0;
+
+    uint64_t printed = 0;
+    for (uint32_t i = 0; i < blockHeader.recordCount; i++) {
+        struct NetflowRecord record;
+        memcpy(&record, block.data() + sizeof(blockHeader) + i * sizeof(record), sizeof(record));
+
+        uint32_t firstSeen = ntohl(record.firstSeen);
+        uint32_t lastSeen = ntohl(record.lastSeen);
+        if (lastSeen < from || firstSeen > to) continue;
+
+        char src[INET_ADDRSTRLEN], dst[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &record.srcIP, src, sizeof(src));
+        inet_ntop(AF_INET, &record.destIP, dst, sizeof(dst));
+        std::cout << src << ":" << ntohs(record.srcPort) << " -> " << dst << ":" << ntohs(record.destPort)
+                  << " packets " << ntohl(record.totalPackets) << " bytes " << ntohl(record.totalBytes) << " first "
+                  << firstSeen << " last " << lastSeen << "\n";
+        printed++;
+    }
+    return printed;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2 && argc != 4) {
+        std::cerr << "Usage: ./flowfile_reader <file> [<from_ms> <to_ms>]\n";
+        return EXIT_FAILURE;
+    }
+
+    uint32_t from = 0, to = UINT32_MAX;
+    if (argc == 4) {
+        from = static_cast<uint32_t>(std::stoul(argv[2]));
+        to = static_cast<uint32_t>(std::stoul(argv[3]));
+    }
+
+    int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        std::cerr << "Error: Could not open " << argv[1] << "\n";
+        return EXIT_FAILURE;
+    }
+
+    struct FlowFileHeader header;
+    if (!readAt(fd, &header, sizeof(header), 0) || header.magic != FLOW_FILE_MAGIC ||
+        header.version != FLOW_FILE_VERSION || header.recordSize != sizeof(struct NetflowRecord)) {
+        std::cerr << "Error: " << argv[1] << " is not a flow file\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<char> block(header.blockSize);
+    uint64_t printed = 0, blocksRead = 0;
+
+    struct FlowFileTrailer trailer;
+    uint64_t fileSize = static_cast<uint64_t>(st.st_size);
+    bool indexed = fileSize >= sizeof(trailer) && readAt(fd, &trailer, sizeof(trailer), fileSize - sizeof(trailer)) &&
+                   trailer.magic == FLOW_FILE_INDEX_MAGIC;
+
+    if (indexed) {
+        std::vector<struct FlowFileIndex> index(trailer.entryCount);
+        if (!index.empty() &&
+            !readAt(fd, index.data(), sizeof(struct FlowFileIndex) * index.size(), trailer.indexOffset)) {
+            std::cerr << "Error: Could not read the block index\n";
+            return EXIT_FAILURE;
+        }
+        for (const auto &entry : index) {
+            if (entry.recordCount == 0 || entry.maxLastSeen < from || entry.minFirstSeen > to) continue;
+            if (!readAt(fd, block.data(), block.size(), entry.offset)) break;
+            printed += printBlock(block, from, to);
+            blocksRead++;
+        }
+    } else {
+        // File was not closed properly, scan the blocks sequentially
+        for (uint64_t offset = FLOW_FILE_ALIGN; readAt(fd, block.data(), block.size(), offset);
+             offset += header.blockSize) {
+            printed += printBlock(block, from, to);
+            blocksRead++;
+        }
+    }
+
+    std::cerr << "records " << printed << " blocks_read " << blocksRead << (indexed ? "" : " (no index)") << "\n";
+    close(fd);
+    return 0;
+}
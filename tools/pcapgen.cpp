@@ -0,0 +1,359 @@
+/**
+ * @file pcapgen.cpp
+ * @brief Deterministic generator of synthetic pcap files for load tests
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * Usage: ./pcapgen -o <file|-> [options], see print_usage()
+ *
+ * The generator keeps a fixed number of concurrent flows. Every flow gets a size in
+ * packets and a duration, its packets are spread over the duration and the flow is
+ * replaced by a new one after its last packet. Only the headers are stored (as with a
+ * short snaplen), the original packet length is kept in the record header, so the
+ * files stay small while the byte counters match full sized traffic. The output is
+ * written sequentially through a large buffer and depends only on the options and
+ * the seed.
+ */
+
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#define WRITE_BUFFER_SIZE (4 << 20)
+
+#define TCP_FIN 0x01
+#define TCP_SYN 0x02
+#define TCP_RST 0x04
+#define TCP_PSH 0x08
+#define TCP_ACK 0x10
+
+struct Options {
+    std::string output;
+    uint64_t seed = 1;
+    uint32_t concurrentFlows = 10000;
+    uint64_t packets = 1000000;
+    double duration = 0;         // seconds of traffic, 0 = limited by packets only
+    double meanSize = 20;        // packets per flow
+    std::string sizeDist = "pareto";
+    double meanDuration = 10;    // seconds per flow
+    double rate = 0;             // packets per second, overrides meanDuration
+    double nonTcp = 0;           // share of UDP flows
+    double vlan = 0;             // share of 802.1Q tagged flows
+    double fin = 0.8;            // share of flows closed by FIN
+    double rst = 0.1;            // share of flows closed by RST
+    uint64_t start = 1700000000; // epoch of the first packet
+};
+
+/**
+ * @class GenFlow
+ * @brief State of one generated flow
+ */
+struct GenFlow {
+    uint64_t nextTime;  // nanoseconds since the start
+    uint64_t gap;       // mean gap between packets in nanoseconds
+    uint32_t remaining;
+    uint32_t sent;
+    uint32_t srcIP, destIP;
+    uint16_t srcPort, destPort;
+    uint32_t seq;
+    uint16_t vlanId;
+    uint8_t protocol;
+    uint8_t closeFlags;
+
+    bool operator>(const GenFlow &other) const { return nextTime > other.nextTime; }
+};
+
+/**
+ * @class PcapWriter
+ * @brief Buffered writer of classic pcap files with microsecond timestamps
+ */
+class PcapWriter {
+   public:
+    PcapWriter(FILE *file) : file(file), buffer(WRITE_BUFFER_SIZE), used(0) {
+        uint32_t header[6] = {0xa1b2c3d4, 0x00040002, 0, 0, 65535, 1};  // version 2.4, Ethernet
+        append(header, sizeof(header));
+    }
+
+    ~PcapWriter() { flush(); }
+
+    void packet(uint64_t timeNs, uint64_t start, const uint8_t *data, uint32_t caplen, uint32_t len) {
+        uint32_t record[4] = {static_cast<uint32_t>(start + timeNs / 1000000000ULL),
+                              static_cast<uint32_t>((timeNs % 1000000000ULL) / 1000), caplen, len};
+        append(record, sizeof(record));
+        append(data, caplen);
+    }
+
+    bool flush() {
+        if (used && fwrite(buffer.data(), 1, used, file) != used) {
+            return false;
+        }
+        used = 0;
+        return fflush(file) == 0;
+    }
+
+   private:
+    void append(const void *data, size_t size) {
+        if (used + size > buffer.size()) {
+            if (fwrite(buffer.data(), 1, used, file) != used) {
+                std::cerr << "Error: Could not write the output\n";
+                exit(EXIT_FAILURE);
+            }
+            used = 0;
+        }
+        memcpy(buffer.data() + used, data, size);
+        used += size;
+    }
+
+    FILE *file;
+    std::vector<uint8_t> buffer;
+    size_t used;
+};
+
+/**
+ * @class Generator
+ * @brief Creates the flows and their packets
+ */
+class Generator {
+   public:
+    Generator(const Options &options) : options(options), rng(options.seed), unit(0, 1) {
+        meanDuration = options.meanDuration;
+        if (options.rate > 0) {
+            // Little's law: concurrent flows = flow arrival rate * flow duration
+            meanDuration = options.concurrentFlows * options.meanSize / options.rate;
+        }
+    }
+
+    uint64_t run(PcapWriter &writer) {
+        std::priority_queue<GenFlow, std::vector<GenFlow>, std::greater<GenFlow>> flows;
+
+        // Start the initial flows spread over one mean gap, so they do not begin at once
+        for (uint32_t i = 0; i < options.concurrentFlows; i++) {
+            flows.push(newFlow(static_cast<uint64_t>(unit(rng) * meanDuration * 1e9 / options.meanSize)));
+        }
+
+        uint64_t limitNs = options.duration > 0 ? static_cast<uint64_t>(options.duration * 1e9) : UINT64_MAX;
+        uint64_t written = 0;
+        uint8_t packet[128];
+
+        while (written < options.packets && !flows.empty()) {
+            GenFlow flow = flows.top();
+            flows.pop();
+            if (flow.nextTime > limitNs) break;
+
+            uint32_t len = 0;
+            uint32_t caplen = buildPacket(flow, packet, &len);
+            writer.packet(flow.nextTime, options.start, packet, caplen, len);
+            written++;
+
+            flow.sent++;
+            flow.remaining--;
+            if (flow.remaining > 0) {
+                flow.nextTime += static_cast<uint64_t>(exponential(static_cast<double>(flow.gap)));
+                flows.push(flow);
+            } else {
+                flows.push(newFlow(flow.nextTime + static_cast<uint64_t>(exponential(1e6))));
+            }
+        }
+
+        return written;
+    }
+
+   private:
+    double exponential(double mean) { return -std::log(1 - unit(rng)) * mean; }
+
+    uint32_t flowSize() {
+        double size;
+        if (options.sizeDist == "fixed") {
+            size = options.meanSize;
+        } else if (options.sizeDist == "exp") {
+            size = 1 + exponential(options.meanSize - 1);
+        } else {
+            // Pareto with shape 1.5 has the requested mean and a heavy tail of elephant flows
+            const double shape = 1.5;
+            double scale = options.meanSize * (shape - 1) / shape;
+            size = scale / std::pow(1 - unit(rng), 1 / shape);
+        }
+        return static_cast<uint32_t>(std::max(1.0, std::min(size, 1e9)));
+    }
+
+    GenFlow newFlow(uint64_t startTime) {
+        GenFlow flow;
+        flow.nextTime = startTime;
+        flow.remaining = flowSize();
+        flow.sent = 0;
+        flow.gap = static_cast<uint64_t>(exponential(meanDuration * 1e9) / flow.remaining);
+        flow.srcIP = 0x0a000000 | static_cast<uint32_t>(rng() & 0xffffff);
+        flow.destIP = 0xc0a80000 | static_cast<uint32_t>(rng() & 0xffff);
+        flow.srcPort = static_cast<uint16_t>(1024 + rng() % 64511);
+        flow.destPort = static_cast<uint16_t>((rng() & 3) ? 443 : 80);
+        flow.seq = static_cast<uint32_t>(rng());
+        flow.vlanId = unit(rng) < options.vlan ? static_cast<uint16_t>(1 + rng() % 4094) : 0;
+        flow.protocol = unit(rng) < options.nonTcp ? IPPROTO_UDP : IPPROTO_TCP;
+
+        double close = unit(rng);
+        flow.closeFlags = close < options.fin ? TCP_FIN | TCP_ACK : close < options.fin + options.rst ? TCP_RST : 0;
+        return flow;
+    }
+
+    uint32_t buildPacket(GenFlow &flow, uint8_t *packet, uint32_t *len) {
+        uint8_t *p = packet;
+        const uint8_t macs[12] = {0x02, 0, 0, 0, 0, 1, 0x02, 0, 0, 0, 0, 2};
+        memcpy(p, macs, sizeof(macs));
+        p += sizeof(macs);
+        if (flow.vlanId) {
+            uint16_t tag[2] = {htons(0x8100), htons(flow.vlanId)};
+            memcpy(p, tag, sizeof(tag));
+            p += sizeof(tag);
+        }
+        uint16_t etherType = htons(0x0800);
+        memcpy(p, &etherType, 2);
+        p += 2;
+
+        // Mostly full sized data packets (1500 byte IP packet) with small control packets
+        uint32_t l4Header = flow.protocol == IPPROTO_TCP ? 20 : 8;
+        uint32_t payload = (unit(rng) < 0.6) ? 1480 - l4Header : static_cast<uint32_t>(rng() % 200);
+        bool first = flow.sent == 0;
+        bool last = flow.remaining == 1;
+        if (flow.protocol == IPPROTO_TCP && (first || (last && flow.closeFlags))) payload = 0;
+        uint16_t ipLength = static_cast<uint16_t>(20 + l4Header + payload);
+
+        uint8_t *ip = p;
+        memset(ip, 0, 20);
+        ip[0] = 0x45;
+        uint16_t field = htons(ipLength);
+        memcpy(ip + 2, &field, 2);
+        field = htons(static_cast<uint16_t>(flow.sent));
+        memcpy(ip + 4, &field, 2);
+        ip[8] = 64;
+        ip[9] = flow.protocol;
+        uint32_t address = htonl(flow.srcIP);
+        memcpy(ip + 12, &address, 4);
+        address = htonl(flow.destIP);
+        memcpy(ip + 16, &address, 4);
+
+        uint32_t sum = 0;
+        for (int i = 0; i < 20; i += 2) sum += (ip[i] << 8) | ip[i + 1];
+        while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+        field = htons(static_cast<uint16_t>(~sum));
+        memcpy(ip + 10, &field, 2);
+        p += 20;
+
+        uint8_t *l4 = p;
+        memset(l4, 0, l4Header);
+        field = htons(flow.srcPort);
+        memcpy(l4, &field, 2);
+        field = htons(flow.destPort);
+        memcpy(l4 + 2, &field, 2);
+        if (flow.protocol == IPPROTO_TCP) {
+            uint32_t seq = htonl(flow.seq);
+            memcpy(l4 + 4, &seq, 4);
+            l4[12] = 0x50;
+            l4[13] = first ? TCP_SYN : (last && flow.closeFlags) ? flow.closeFlags : TCP_ACK | (payload ? TCP_PSH : 0);
+            field = htons(65535);
+            memcpy(l4 + 14, &field, 2);
+            flow.seq += payload + (first ? 1 : 0);
+        } else {
+            field = htons(static_cast<uint16_t>(8 + payload));
+            memcpy(l4 + 4, &field, 2);
+        }
+        p += l4Header;
+
+        *len = static_cast<uint32_t>(p - packet) + payload;
+        return static_cast<uint32_t>(p - packet);
+    }
+
+    const Options &options;
+    std::mt19937_64 rng;
+    std::uniform_real_distribution<double> unit;
+    double meanDuration;
+};
+
+static void print_usage() {
+    std::cerr << "Usage: ./pcapgen -o <file|-> [options]\n"
+                 "  --seed <n>             seed of the generator (1)\n"
+                 "  --flows <n>            number of concurrent flows (10000)\n"
+                 "  --packets <n>          number of packets to write (1000000)\n"
+                 "  --duration <s>         stop after this much traffic time (unlimited)\n"
+                 "  --mean-size <packets>  mean flow size in packets (20)\n"
+                 "  --size-dist <d>        pareto, exp or fixed (pareto)\n"
+                 "  --mean-duration <s>    mean flow duration, exponential (10)\n"
+                 "  --rate <packets/s>     target packet rate, sets the mean flow duration\n"
+                 "  --non-tcp <share>      share of UDP flows (0)\n"
+                 "  --vlan <share>         share of 802.1Q tagged flows (0)\n"
+                 "  --fin <share>          share of flows ended by FIN (0.8)\n"
+                 "  --rst <share>          share of flows ended by RST (0.1), the rest just stops\n"
+                 "  --start <epoch>        time of the first packet (1700000000)\n";
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "-o") options.output = value;
+            else if (arg == "--seed") options.seed = std::stoull(value);
+            else if (arg == "--flows") options.concurrentFlows = static_cast<uint32_t>(std::stoul(value));
+            else if (arg == "--packets") options.packets = std::stoull(value);
+            else if (arg == "--duration") options.duration = std::stod(value);
+            else if (arg == "--mean-size") options.meanSize = std::stod(value);
+            else if (arg == "--size-dist") options.sizeDist = value;
+            else if (arg == "--mean-duration") options.meanDuration = std::stod(value);
+            else if (arg == "--rate") options.rate = std::stod(value);
+            else if (arg == "--non-tcp") options.nonTcp = std::stod(value);
+            else if (arg == "--vlan") options.vlan = std::stod(value);
+            else if (arg == "--fin") options.fin = std::stod(value);
+            else if (arg == "--rst") options.rst = std::stod(value);
+            else if (arg == "--start") options.start = std::stoull(value);
+            else {
+                print_usage();
+                return EXIT_FAILURE;
+            }
+        } catch (std::exception const &ex) {
+            std::cerr << "Invalid value of " << arg << ": " << value << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.output.empty() || options.concurrentFlows == 0 || options.meanSize < 1 ||
+        (options.sizeDist != "pareto" && options.sizeDist != "exp" && options.sizeDist != "fixed")) {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    FILE *file = options.output == "-" ? stdout : fopen(options.output.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error: Could not open " << options.output << "\n";
+        return EXIT_FAILURE;
+    }
+    setvbuf(file, nullptr, _IONBF, 0);
+
+    uint64_t written;
+    {
+        PcapWriter writer(file);
+        Generator generator(options);
+        written = generator.run(writer);
+        if (!writer.flush()) {
+            std::cerr << "Error: Could not write the output\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (file != stdout) fclose(file);
+    std::cerr << "packets " << written << "\n";
+    return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file shm_reader.cpp
+ * @brief Example consumer of the shared memory export ring
+ * @author Jakub Gryc <xgrycj03>
+ *
+ * Usage: ./shm_reader <name> [--oldest]
+ * Attaches to the ring, reads datagrams until the producer closes the ring and prints
+ * the number of datagrams, records, flow sequence gaps and datagrams lost by overruns.
+ */
+
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "../include/ExportSink.h"
+#include "../include/ShmRing.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: ./shm_reader <name> [--oldest]\n";
+        return EXIT_FAILURE;
+    }
+
+    std::string name = argv[1];
+    if (name[0] != '/') name = "/" + name;
+    bool fromOldest = argc > 2 && std::string(argv[2]) == "--oldest";
+
+    ShmRingReader reader(name);
+    while (!reader.attach(fromOldest)) {
+        // Wait for the producer to create the ring
+        usleep(10000);
+    }
+
+    char buffer[MAX_DATAGRAM_SIZE];
+    uint64_t datagrams = 0, records = 0, gaps = 0;
+    uint32_t expectedSequence = 0;
+
+    while (!reader.finished()) {
+        size_t size = reader.read(buffer, sizeof(buffer));
+        if (size < sizeof(struct NetflowHeader)) {
+            if (size == 0) usleep(1000);
+            continue;
+        }
+
+        struct NetflowHeader header;
+        memcpy(&header, buffer, sizeof(header));
+        uint32_t sequence = ntohl(header.flowSequence);
+        if (datagrams > 0 && sequence != expectedSequence) gaps++;
+        expectedSequence = sequence + ntohs(header.flowCount);
+
+        datagrams++;
+        records += ntohs(header.flowCount);
+    }
+
+    std::cout << "datagrams " << datagrams << " records " << records << " sequence_gaps " << gaps << " lost "
+              << reader.lost() << "\n";
+
+    return 0;
+}